@@ -0,0 +1,274 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <memory>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "Geometry/AABB.hpp"
+#include "Ray.hpp"
+
+/**
+ * @brief
+ * Ray casting against a list of objects costs O(N) per ray, since every object has to be tested.
+ * Acceleration structures reduce this cost by organizing the objects spatially, so that a ray only
+ * tests the objects that are near its path.
+ *
+ * A Bounding Volume Hierarchy (BVH) is a binary tree where each node stores the bounding box of
+ * everything below it. Inner nodes have two children, while leaves reference a small set of primitives.
+ * A ray that misses a node's box cannot hit anything inside it, so the whole subtree is skipped.
+ * With a good tree, the cost of ray casting becomes roughly O(log N).
+ *
+ * The quality of the tree depends on how primitives are split between children.
+ * The Surface Area Heuristic (SAH) estimates the cost of a split by assuming that the probability
+ * of a random ray hitting a child is proportional to the ratio of the surface areas of the child and parent boxes:
+ * C = C_trav + (A_left / A) * N_left * C_isect + (A_right / A) * N_right * C_isect
+ * The builder evaluates this cost for a set of candidate planes, obtained by binning the primitive
+ * centroids along each axis, and picks the cheapest one. If no split is cheaper than testing
+ * all primitives directly, a leaf is created.
+ *
+ * The tree is stored flattened in a single array. The two children of an inner node are allocated
+ * as an adjacent pair, so a node only keeps the index of its first child. Pairs are reserved with an
+ * atomic counter, which lets the builder construct independent subtrees on different threads:
+ * once a node is split, its two halves of the primitive array never overlap.
+ * Large nodes are also binned in parallel, since the first levels of the tree touch every primitive
+ * before there are enough subtrees to keep all cores busy.
+ * The BVH only deals with bounding boxes and primitive indices, so the same structure can be used
+ * for scene objects as well as for any other set of primitives.
+ *
+ * The node and index arrays are read through spans, so a hierarchy can also be used directly from memory
+ * it does not own, such as a memory-mapped file; the storage is kept alive by a shared owner.
+ * For the same reason, copying a BVH is cheap and the copies share the same arrays.
+ */
+class BVH
+{
+public:
+	struct Node
+	{
+		AABB bounds;
+		uint32_t offset;						// leaf: first entry in the primitive indices, inner: first child index
+		uint16_t primitive_count;		// 0 for inner nodes
+		uint8_t axis;								// split axis of inner nodes
+		uint8_t padding;
+
+		bool isLeaf() const { return primitive_count > 0; }
+	};
+
+	/** @brief Size of the traversal stacks: no node is more than TRAVERSAL_STACK_SIZE - 1 levels below the root */
+	static constexpr uint32_t TRAVERSAL_STACK_SIZE = 64;
+
+	struct BuildStats
+	{
+		float build_time_ms;
+		uint32_t node_count;
+		uint32_t leaf_count;
+		uint32_t max_depth;
+		uint32_t thread_count;
+	};
+
+	BVH() = default;
+	~BVH() = default;
+
+	/** @brief Build the hierarchy over the given primitive bounds. Previous content is discarded. */
+	void build(std::span<const AABB> primitive_bounds, uint32_t max_leaf_size = 4);
+
+	/** @brief Use a hierarchy built beforehand, stored in memory kept alive by storage */
+	void assign(std::span<const Node> nodes,
+							std::span<const uint32_t> primitive_indices,
+							std::shared_ptr<const void> storage);
+	void clear();
+
+	bool isBuilt() const { return !__nodes.empty(); }
+	auto getNodes() const { return __nodes; }
+
+	/** @brief The primitive indices in leaf order; leaves reference contiguous ranges of this array */
+	auto getPrimitiveIndices() const { return __primitive_indices; }
+	AABB getBounds() const { return __nodes.empty() ? AABB() : __nodes[0].bounds; }
+	const auto& getBuildStats() const { return __build_stats; }
+
+	/**
+	 * @brief Traverse the hierarchy front to back.
+	 * The callback is invoked as intersect_primitive(leaf_slot, t_min, t_max) for every primitive in the
+	 * leaves reached by the ray, where leaf_slot indexes getPrimitiveIndices(). It returns true on a hit and
+	 * shrinks t_max to the hit distance, so that farther nodes get culled.
+	 */
+	template<typename IntersectFn>
+	bool intersect(const Ray& ray,
+								 float t_min,
+								 float& t_max,
+								 IntersectFn&& intersect_primitive) const;
+
+	/**
+	 * @brief Same as intersect, but the callback receives whole leaves: intersect_leaf(first_slot, count, t_min, t_max).
+	 * It lets the caller test the primitives of a leaf together, e.g. with SIMD instructions.
+	 */
+	template<typename IntersectLeafFn>
+	bool intersectLeaves(const Ray& ray,
+											 float t_min,
+											 float& t_max,
+											 IntersectLeafFn&& intersect_leaf) const;
+
+	/**
+	 * @brief Any-hit traversal, used for visibility queries.
+	 * The callback is invoked as occludes_primitive(leaf_slot, t_min, t_max) and returns true if the primitive
+	 * blocks the segment. The traversal stops at the first blocking primitive, without looking for the closest one.
+	 */
+	template<typename OccludesFn>
+	bool occluded(const Ray& ray,
+								float t_min,
+								float t_max,
+								OccludesFn&& occludes_primitive) const;
+
+	/** @brief Same as occluded, but the callback receives whole leaves: occludes_leaf(first_slot, count, t_min, t_max) */
+	template<typename OccludesLeafFn>
+	bool occludedLeaves(const Ray& ray,
+											float t_min,
+											float t_max,
+											OccludesLeafFn&& occludes_leaf) const;
+
+private:
+	struct BuildContext;
+
+	static void __buildRecursive(BuildContext& context,
+															 uint32_t node_index,
+															 std::span<uint32_t> indices,
+															 uint32_t first,
+															 uint32_t depth);
+
+	std::span<const Node> __nodes;
+	std::span<const uint32_t> __primitive_indices;
+	std::shared_ptr<const void> __storage;		// owner of the memory referenced by the spans
+	BuildStats __build_stats{};
+};
+
+template<typename IntersectFn>
+inline bool BVH::intersect(const Ray& ray,
+													 float t_min,
+													 float& t_max,
+													 IntersectFn&& intersect_primitive) const
+{
+	return intersectLeaves(ray, t_min, t_max, [&](uint32_t first_slot, uint32_t count, float t_near, float& t_far) -> bool {
+		auto hit = false;
+		for (auto i = 0u; i < count; ++i)
+			if (intersect_primitive(first_slot + i, t_near, t_far))
+				hit = true;
+		return hit;
+	});
+}
+
+template<typename IntersectLeafFn>
+inline bool BVH::intersectLeaves(const Ray& ray,
+																 float t_min,
+																 float& t_max,
+																 IntersectLeafFn&& intersect_leaf) const
+{
+	if (__nodes.empty())
+		return false;
+
+	auto inv_direction = 1.f / ray.direction;
+	const bool dir_is_neg[3] = { inv_direction.x < 0.f, inv_direction.y < 0.f, inv_direction.z < 0.f };
+
+	auto hit = false;
+	uint32_t stack[TRAVERSAL_STACK_SIZE];
+	auto stack_size = 0u;
+	auto node_index = 0u;
+	while (true)
+	{
+		const auto& node = __nodes[node_index];
+		if (node.bounds.intersect(ray.origin, inv_direction, t_min, t_max))
+		{
+			if (node.isLeaf())
+			{
+				if (intersect_leaf(node.offset, node.primitive_count, t_min, t_max))
+					hit = true;
+
+				if (stack_size == 0)
+					break;
+				node_index = stack[--stack_size];
+			}
+			else if (dir_is_neg[node.axis])
+			{
+				// Visit the second child first, it is the nearest along the ray
+				stack[stack_size++] = node.offset;
+				node_index = node.offset + 1;
+			}
+			else
+			{
+				stack[stack_size++] = node.offset + 1;
+				node_index = node.offset;
+			}
+		}
+		else
+		{
+			if (stack_size == 0)
+				break;
+			node_index = stack[--stack_size];
+		}
+	}
+	return hit;
+}
+
+template<typename OccludesFn>
+inline bool BVH::occluded(const Ray& ray,
+													float t_min,
+													float t_max,
+													OccludesFn&& occludes_primitive) const
+{
+	return occludedLeaves(ray, t_min, t_max, [&](uint32_t first_slot, uint32_t count, float t_near, float t_far) -> bool {
+		for (auto i = 0u; i < count; ++i)
+			if (occludes_primitive(first_slot + i, t_near, t_far))
+				return true;
+		return false;
+	});
+}
+
+template<typename OccludesLeafFn>
+inline bool BVH::occludedLeaves(const Ray& ray,
+																float t_min,
+																float t_max,
+																OccludesLeafFn&& occludes_leaf) const
+{
+	if (__nodes.empty())
+		return false;
+
+	auto inv_direction = 1.f / ray.direction;
+	const bool dir_is_neg[3] = { inv_direction.x < 0.f, inv_direction.y < 0.f, inv_direction.z < 0.f };
+
+	uint32_t stack[TRAVERSAL_STACK_SIZE];
+	auto stack_size = 0u;
+	auto node_index = 0u;
+	while (true)
+	{
+		const auto& node = __nodes[node_index];
+		if (node.bounds.intersect(ray.origin, inv_direction, t_min, t_max))
+		{
+			if (node.isLeaf())
+			{
+				if (occludes_leaf(node.offset, node.primitive_count, t_min, t_max))
+					return true;
+
+				if (stack_size == 0)
+					break;
+				node_index = stack[--stack_size];
+			}
+			else if (dir_is_neg[node.axis])
+			{
+				stack[stack_size++] = node.offset;
+				node_index = node.offset + 1;
+			}
+			else
+			{
+				stack[stack_size++] = node.offset + 1;
+				node_index = node.offset;
+			}
+		}
+		else
+		{
+			if (stack_size == 0)
+				break;
+			node_index = stack[--stack_size];
+		}
+	}
+	return false;
+}
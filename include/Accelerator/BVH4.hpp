@@ -0,0 +1,257 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "Accelerator/BVH.hpp"
+#include "Ray.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <xmmintrin.h>
+	#define BVH4_SSE
+#endif
+
+/**
+ * @brief
+ * A BVH with four children per node (QBVH, Dammertz et al., "Shallow Bounding Volume Hierarchies
+ * for Fast SIMD Ray Tracing of Incoherent Rays", 2008).
+ * A binary BVH tests one box at a time, which leaves the SIMD units idle. Here a node stores the boxes
+ * of its four children as a structure of arrays (all min x together, all min y together, ...),
+ * so one ray is tested against the four boxes with a single sequence of 4-wide SSE instructions.
+ * The tree is also half as deep, so there are fewer nodes to fetch per ray.
+ *
+ * It is not built from the primitives directly: the nodes of a binary SAH BVH are collapsed, each 4-wide node
+ * taking the place of a binary node and of up to two levels of descendants. The leaves are the leaves
+ * of the binary tree, so the primitive order (and the slots passed to the callbacks) is the same.
+ *
+ * The children hit by the ray are visited front to back: they are sorted by entry distance before being
+ * pushed on the stack, and a popped entry farther than the closest hit found so far is skipped.
+ */
+class BVH4
+{
+public:
+	struct alignas(16) Node
+	{
+		float bounds_min[3][4];				// [axis][child]
+		float bounds_max[3][4];
+		uint32_t child[4];						// inner child: node index, leaf child: first primitive slot
+		uint16_t primitive_count[4];	// 0 for inner children and empty lanes
+		uint32_t child_count;
+	};
+
+	BVH4() = default;
+	~BVH4() = default;
+
+	/** @brief Collapse a binary BVH. The primitive slots are those of bvh.getPrimitiveIndices(). */
+	void build(const BVH& bvh);
+	void clear() { __nodes.clear(); }
+
+	bool isBuilt() const { return !__nodes.empty(); }
+	const auto& getNodes() const { return __nodes; }
+
+	/** @brief Closest-hit traversal, with the same callback as BVH::intersect */
+	template<typename IntersectFn>
+	bool intersect(const Ray& ray,
+								 float t_min,
+								 float& t_max,
+								 IntersectFn&& intersect_primitive) const;
+
+	/** @brief Any-hit traversal, with the same callback as BVH::occluded */
+	template<typename OccludesFn>
+	bool occluded(const Ray& ray,
+								float t_min,
+								float t_max,
+								OccludesFn&& occludes_primitive) const;
+
+private:
+	struct StackEntry
+	{
+		uint32_t child;
+		uint32_t primitive_count;
+		float t_near;
+	};
+
+	/** @brief Ray data reused by every node test */
+	struct RayBoxes
+	{
+		RayBoxes(const Ray& ray);
+
+		glm::vec3 origin;
+		glm::vec3 inv_direction;
+		int near_plane[3];						// 0 selects bounds_min, 1 bounds_max, per axis
+	};
+
+	uint32_t __collapse(const BVH& bvh, uint32_t binary_index);
+
+	/** @brief Test the four children of a node, return the mask of the ones hit in [t_min, t_max] and their entry distances */
+	static int __intersectChildren(const Node& node,
+																 const RayBoxes& ray_boxes,
+																 float t_min,
+																 float t_max,
+																 float t_near[4]);
+
+	/** @brief Push the children hit by the ray, the farthest first, so that the nearest is visited next */
+	static void __pushChildren(const Node& node,
+														 int hit_mask,
+														 const float t_near[4],
+														 StackEntry* stack,
+														 uint32_t& stack_size);
+
+	std::vector<Node> __nodes;
+};
+
+inline BVH4::RayBoxes::RayBoxes(const Ray& ray) :
+	origin{ ray.origin },
+	inv_direction{ 1.f / ray.direction }
+{
+	// With a negative direction the ray enters a box through its max plane
+	for (auto axis = 0; axis < 3; ++axis)
+		near_plane[axis] = inv_direction[axis] < 0.f ? 1 : 0;
+}
+
+inline int BVH4::__intersectChildren(const Node& node,
+																		 const RayBoxes& ray_boxes,
+																		 float t_min,
+																		 float t_max,
+																		 float t_near[4])
+{
+	// Empty lanes have inverted bounds (+inf min, -inf max), so their entry distance is +inf and they are never hit.
+	// NaNs (a ray in the plane of a face) are discarded by the order of the min/max operands, as in AABB::intersect.
+	const float* planes[2][3] = {
+		{ node.bounds_min[0], node.bounds_min[1], node.bounds_min[2] },
+		{ node.bounds_max[0], node.bounds_max[1], node.bounds_max[2] },
+	};
+	constexpr auto far_scale = 1.f + 2.f * 3.f * std::numeric_limits<float>::epsilon();
+
+#if defined(BVH4_SSE)
+	auto entry = _mm_set1_ps(t_min);
+	auto exit = _mm_set1_ps(t_max);
+	for (auto axis = 0; axis < 3; ++axis)
+	{
+		auto origin = _mm_set1_ps(ray_boxes.origin[axis]);
+		auto inv_direction = _mm_set1_ps(ray_boxes.inv_direction[axis]);
+		auto near_side = ray_boxes.near_plane[axis];
+		auto t0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(planes[near_side][axis]), origin), inv_direction);
+		auto t1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(planes[1 - near_side][axis]), origin), inv_direction);
+		entry = _mm_max_ps(t0, entry);
+		exit = _mm_min_ps(_mm_mul_ps(t1, _mm_set1_ps(far_scale)), exit);
+	}
+	_mm_storeu_ps(t_near, entry);
+	return _mm_movemask_ps(_mm_cmple_ps(entry, exit));
+#else
+	auto hit_mask = 0;
+	for (auto i = 0; i < 4; ++i)
+	{
+		auto entry = t_min;
+		auto exit = t_max;
+		for (auto axis = 0; axis < 3; ++axis)
+		{
+			auto near_side = ray_boxes.near_plane[axis];
+			auto t0 = (planes[near_side][axis][i] - ray_boxes.origin[axis]) * ray_boxes.inv_direction[axis];
+			auto t1 = (planes[1 - near_side][axis][i] - ray_boxes.origin[axis]) * ray_boxes.inv_direction[axis] * far_scale;
+			entry = t0 > entry ? t0 : entry;
+			exit = t1 < exit ? t1 : exit;
+		}
+		t_near[i] = entry;
+		if (entry <= exit)
+			hit_mask |= 1 << i;
+	}
+	return hit_mask;
+#endif
+}
+
+inline void BVH4::__pushChildren(const Node& node,
+																 int hit_mask,
+																 const float t_near[4],
+																 StackEntry* stack,
+																 uint32_t& stack_size)
+{
+	// Insertion sort of at most four entries, by decreasing distance
+	StackEntry hits[4];
+	auto hit_count = 0u;
+	for (auto i = 0u; i < 4; ++i)
+	{
+		if (!(hit_mask & (1 << i)))
+			continue;
+		auto entry = StackEntry{ node.child[i], node.primitive_count[i], t_near[i] };
+		auto j = hit_count++;
+		for (; j > 0 && hits[j - 1].t_near < entry.t_near; --j)
+			hits[j] = hits[j - 1];
+		hits[j] = entry;
+	}
+	for (auto i = 0u; i < hit_count; ++i)
+		stack[stack_size++] = hits[i];
+}
+
+template<typename IntersectFn>
+inline bool BVH4::intersect(const Ray& ray,
+														float t_min,
+														float& t_max,
+														IntersectFn&& intersect_primitive) const
+{
+	if (__nodes.empty())
+		return false;
+
+	auto ray_boxes = RayBoxes(ray);
+	auto hit = false;
+	StackEntry stack[256];
+	auto stack_size = 0u;
+	stack[stack_size++] = StackEntry{ 0u, 0u, t_min };
+	while (stack_size > 0)
+	{
+		auto entry = stack[--stack_size];
+		if (entry.t_near > t_max)
+			continue;
+
+		if (entry.primitive_count > 0)
+		{
+			for (auto i = 0u; i < entry.primitive_count; ++i)
+				if (intersect_primitive(entry.child + i, t_min, t_max))
+					hit = true;
+			continue;
+		}
+
+		const auto& node = __nodes[entry.child];
+		float t_near[4];
+		auto hit_mask = __intersectChildren(node, ray_boxes, t_min, t_max, t_near);
+		__pushChildren(node, hit_mask, t_near, stack, stack_size);
+	}
+	return hit;
+}
+
+template<typename OccludesFn>
+inline bool BVH4::occluded(const Ray& ray,
+													 float t_min,
+													 float t_max,
+													 OccludesFn&& occludes_primitive) const
+{
+	if (__nodes.empty())
+		return false;
+
+	// Any hit will do, so the children are not sorted
+	auto ray_boxes = RayBoxes(ray);
+	uint32_t stack[256];
+	auto stack_size = 0u;
+	stack[stack_size++] = 0u;
+	while (stack_size > 0)
+	{
+		const auto& node = __nodes[stack[--stack_size]];
+		float t_near[4];
+		auto hit_mask = __intersectChildren(node, ray_boxes, t_min, t_max, t_near);
+		for (auto i = 0u; i < 4; ++i)
+		{
+			if (!(hit_mask & (1 << i)))
+				continue;
+			if (node.primitive_count[i] == 0)
+			{
+				stack[stack_size++] = node.child[i];
+				continue;
+			}
+			for (auto j = 0u; j < node.primitive_count[i]; ++j)
+				if (occludes_primitive(node.child[i] + j, t_min, t_max))
+					return true;
+		}
+	}
+	return false;
+}
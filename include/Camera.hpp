@@ -2,11 +2,32 @@
 
 #include <glm/glm.hpp>
 #include <memory>
+#include <vector>
+#include <filesystem>
 
 #include "Renderer.hpp"
+#include "Denoiser.hpp"
 
 class Scene;
 class Ray;
+class ISampler;
+class WavefrontRenderer;
+
+/** @brief How the paths of a pass are traced */
+enum class Integrator
+{
+	MEGAKERNEL,		// Renderer: each path from start to end, pixel by pixel
+	WAVEFRONT,		// WavefrontRenderer: batches of paths, one bounce at a time
+};
+
+/** @brief How the samples of a pixel are distributed (see ISampler) */
+enum class SamplerType
+{
+	INDEPENDENT,	// IndependentSampler: uniform random numbers
+	STRATIFIED,		// StratifiedSampler: jittered strata, over the samples_per_pixel samples of a render
+	SOBOL,				// SobolSampler: Owen-scrambled Sobol points
+	BLUE_NOISE,		// BlueNoiseSampler: Sobol points shifted per pixel by a blue-noise mask
+};
 
 class Camera
 {
@@ -18,7 +39,7 @@ public:
 		float focal_length = 50.f,													// default focal length: 50mm
 		const glm::vec2& sensor_size = { 36.f, 27.f }				// default sensor size: 36mm x 27mm
 	);
-	~Camera() = default;
+	~Camera();
 
 	// Camera frame
 	glm::vec3 position;						// lens center
@@ -27,20 +48,147 @@ public:
 	glm::vec2 sensor_size;				// in mm
 	glm::uvec2 image_resolution;	// in pixels
 	uint32_t samples_per_pixel;
+	uint32_t samples_per_pass;		// captureImage renders in progressive passes of this many samples, 0 for a single pass
 	float focal_length;						// in mm
 
+	// Thin lens: with an aperture, only the points at focus_distance from the lens are sharp (depth of field)
+	float aperture_radius;				// 0 for a pinhole camera
+	float focus_distance;					// along the viewing direction, in scene units
+
+	// Path tracing
+	uint32_t max_depth;								// maximum number of bounces per path
+	uint32_t russian_roulette_depth;	// bounces before paths can be terminated by Russian roulette
+	uint64_t seed;										// the same seed always produces the same image
+	SamplerType sampler_type;
+	Integrator integrator;
+	uint32_t wavefront_batch_size;		// number of paths traced together by the wavefront integrator
+	LightSelection light_selection;		// lights sampled at each bounce: all of them, or one chosen by power for scenes with many lights
+
+	// Work scheduling
+	uint32_t tile_size;								// side of the square tiles handed to the render threads, in pixels
+	uint32_t thread_count;						// number of render threads, 0 uses all hardware threads
+
+	// Adaptive sampling: instead of samples_per_pixel, each pixel takes between min and max samples.
+	// After the first min samples, only the pixels whose error is still above the threshold keep
+	// receiving batches of samples, so the budget saved on flat regions is spent on the noisy ones.
+	bool adaptive_sampling;
+	uint32_t min_samples_per_pixel;
+	uint32_t max_samples_per_pixel;
+	uint32_t adaptive_batch_size;			// samples added to the active pixels by each adaptive pass
+	float adaptive_threshold;					// relative standard error at which a pixel is converged
+
+	// Checkpointing: when a path is set, the accumulated samples are saved to it between passes,
+	// at most once every checkpoint_interval seconds, and captureImage resumes from it if it already exists.
+	// Use samples_per_pass (or adaptive sampling) to get passes short enough to checkpoint.
+	std::filesystem::path checkpoint_path;
+	float checkpoint_interval;
+
+	// Denoising: the resolved images are filtered by the denoiser, guided by the albedo, normal and depth of the first hits.
+	// Smooth lighting then converges with far fewer samples per pixel, at the cost of some blur on fine details.
+	// The first hits are only gathered by the samples rendered while denoising is on.
+	bool denoising;
+	Denoiser denoiser;
+
+	/**
+	 * @brief Render the scene from scratch with samples_per_pixel samples (or adaptively).
+	 * Samples are accumulated in a float HDR buffer: the render can later be continued with refineImage,
+	 * and resolveImage converts the current estimate to an 8-bit image at any time. captureImage does not resolve
+	 * the image itself, so that a denoised render is only filtered once, by the resolveImage call that needs it.
+	 */
 	void captureImage(const Scene& scene) const;
+
+	/** @brief Add a progressive pass of samples per pixel to the accumulation buffer (only noisy pixels in adaptive mode) */
+	void refineImage(const Scene& scene, uint32_t samples) const;
+
+	/** @brief Discard all accumulated samples */
+	void clearImage() const;
+
+	/** @brief Convert the accumulated radiance (denoised if enabled) to the 8-bit image, applying gamma correction if gamma is not 1 */
+	void resolveImage(float gamma = 1.f) const;
+
+	/** @brief Current per-pixel estimate of the radiance, in linear HDR, denoised if enabled */
+	std::vector<glm::vec3> resolveHDRImage() const;
+
+	/**
+	 * @brief Current per-pixel estimate of the auxiliary buffers (albedo, normal and depth of the first hits),
+	 * averaged over the samples rendered with denoising on; zero for the pixels that have none.
+	 */
+	std::vector<AuxiliarySample> resolveAuxiliaryImage() const;
+
 	void applyGammaCorrection(float gamma) const;
 	auto getImageData() const { return __image_data.get(); }
 
+	/** @brief RGB image of the number of samples taken by each pixel, from black (none) to white (the most) */
+	std::shared_ptr<std::byte[]> computeSampleCountHeatmap() const;
+
 private:
+	/** @brief Per-pixel accumulated samples: color sum and running luminance statistics (Welford's method) */
+	struct PixelStatistics
+	{
+		glm::vec3 color_sum;
+		float luminance_mean;
+		float luminance_m2;
+		uint32_t sample_count;
+	};
+
+	/** @brief Per-pixel AOV sums, over the samples rendered with denoising on */
+	struct PixelAuxiliary
+	{
+		glm::vec3 albedo_sum;
+		glm::vec3 normal_sum;
+		float depth_sum;
+		uint32_t sample_count;
+	};
+
+	struct CheckpointWriter;
+
 	// Setup camera frame and imaging surface
 	void __computeCameraFrame(const glm::vec3& target); // build an orthonormal basis
 	void __computeImagingSurface();											// set up the imaging plane in world space
-	Ray __generateRay(int x, int y, glm::vec2& offset) const;
+	/** @brief Camera ray through the point offset (in [-0.5, 0.5)^2) of pixel (x, y), leaving the lens at the point lens_u (in [0, 1)^2) */
+	Ray __generateRay(int x, int y, const glm::vec2& offset, const glm::vec2& lens_u) const;
+
+	/** @brief A new sampler of sampler_type, stratified over the number of samples of a render */
+	std::unique_ptr<ISampler> __createSampler() const;
+
+	/** @brief Add sample_count samples to every active pixel (all pixels if active_pixels is null) */
+	void __renderPass(const Scene& scene,
+										uint32_t sample_count,
+										const std::vector<uint8_t>* active_pixels) const;
+
+	/** @brief __renderPass with the wavefront integrator: every sample has its own random sequence */
+	void __renderWavefrontPass(const Scene& scene,
+														 uint32_t sample_count,
+														 const std::vector<uint8_t>* active_pixels) const;
+
+	/** @brief Add a sample to the color sum and to the running luminance statistics */
+	static void __addSample(PixelStatistics& statistics, const glm::vec3& sample_color);
+
+	/** @brief Add the AOVs of a sample to the AOV sums */
+	static void __addAuxiliarySample(PixelAuxiliary& auxiliary_sums, const AuxiliarySample& auxiliary);
+
+	/** @brief Whether some pixel has AOV sums, i.e. whether a checkpoint must save them */
+	bool __hasAuxiliarySamples() const;
+
+	/**
+	 * @brief Add batches of samples to the pixels that are not converged yet, at most sample_budget per pixel.
+	 * If a checkpoint writer is given, it is notified at the end of every pass.
+	 */
+	void __renderAdaptivePasses(const Scene& scene, uint32_t sample_budget, CheckpointWriter* checkpoint = nullptr) const;
+	float __estimatePixelError(const PixelStatistics& statistics) const;
+	uint32_t __getThreadCount() const;
+
+	/** @brief Hash of the scene and of the camera settings that a checkpoint must have been rendered with */
+	uint64_t __computeFingerprint(const Scene& scene) const;
+
+	/** @brief Replace the accumulated samples with the content of the checkpoint file, if its fingerprint matches */
+	bool __loadCheckpoint(uint64_t fingerprint) const;
 
 	Renderer __renderer;
+	mutable std::unique_ptr<WavefrontRenderer> __wavefront_renderer; // kept between passes, with its threads and path buffers
 	std::shared_ptr<std::byte[]> __image_data; // final image
+	std::shared_ptr<PixelStatistics[]> __pixel_statistics; // float HDR accumulation buffer
+	std::shared_ptr<PixelAuxiliary[]> __pixel_auxiliary; // AOV accumulation buffer, for the denoiser
 
 	// Camera frame
 	glm::vec3 __forward;    // -Z axis
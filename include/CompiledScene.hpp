@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <span>
+#include <cstdint>
+
+#include "Geometry/Sphere.hpp"
+#include "Geometry/Plane.hpp"
+
+/**
+ * @brief
+ * Flat, render-time copy of the scene objects, grouped by concrete type.
+ * The scene is described with shared pointers to IHittableObject, which is convenient to build it but not to trace it:
+ * every candidate is a virtual call on an object allocated somewhere on the heap.
+ * Here the spheres and the planes are copied by value into two contiguous arrays, and each BVH slot only stores
+ * the type of its object and its index in the array of that type. A switch on the type calls Sphere and Plane
+ * directly (they are final), so the calls can be inlined; any other object (meshes, instances, ...) keeps
+ * the virtual call, which is amortized over the many primitives it contains.
+ */
+class CompiledScene
+{
+public:
+	enum class PrimitiveType : uint32_t
+	{
+		SPHERE,
+		PLANE,
+		OBJECT,		// any other object, called through IHittableObject
+	};
+
+	struct PrimitiveRef
+	{
+		PrimitiveType type;
+		uint32_t index;		// into the array of its type
+	};
+
+	CompiledScene() = default;
+	~CompiledScene() = default;
+
+	/** @brief Copy the objects in the order given by slot_order (objects[slot_order[slot]] goes in slot) */
+	void build(const std::vector<std::shared_ptr<IHittableObject>>& objects, std::span<const uint32_t> slot_order);
+	void clear();
+
+	auto getSlotCount() const { return static_cast<uint32_t>(__primitives.size()); }
+	auto getSphereCount() const { return static_cast<uint32_t>(__spheres.size()); }
+	auto getPlaneCount() const { return static_cast<uint32_t>(__planes.size()); }
+
+	/** @brief The object in slot: the copy for spheres and planes, which is the one recorded in HitRecord::object */
+	const IHittableObject& getObject(uint32_t slot) const;
+
+	/** @brief IHittableObject::intersect on the object in slot */
+	bool intersect(uint32_t slot,
+								 const Ray& ray,
+								 float t_min,
+								 float t_max,
+								 HitRecord& hit) const;
+
+	/** @brief IHittableObject::occludes on the object in slot */
+	bool occludes(uint32_t slot,
+								const Ray& ray,
+								float t_min,
+								float t_max) const;
+
+private:
+	std::vector<PrimitiveRef> __primitives;		// per slot
+	std::vector<Sphere> __spheres;
+	std::vector<Plane> __planes;
+	std::vector<const IHittableObject*> __objects;
+};
+
+inline bool CompiledScene::intersect(uint32_t slot,
+																		 const Ray& ray,
+																		 float t_min,
+																		 float t_max,
+																		 HitRecord& hit) const
+{
+	auto primitive = __primitives[slot];
+	switch (primitive.type)
+	{
+	case PrimitiveType::SPHERE:	return __spheres[primitive.index].intersect(ray, t_min, t_max, hit);
+	case PrimitiveType::PLANE:	return __planes[primitive.index].intersect(ray, t_min, t_max, hit);
+	default:										return __objects[primitive.index]->intersect(ray, t_min, t_max, hit);
+	}
+}
+
+inline bool CompiledScene::occludes(uint32_t slot,
+																		const Ray& ray,
+																		float t_min,
+																		float t_max) const
+{
+	auto primitive = __primitives[slot];
+	switch (primitive.type)
+	{
+	case PrimitiveType::SPHERE:	return __spheres[primitive.index].occludes(ray, t_min, t_max);
+	case PrimitiveType::PLANE:	return __planes[primitive.index].occludes(ray, t_min, t_max);
+	default:										return __objects[primitive.index]->occludes(ray, t_min, t_max);
+	}
+}
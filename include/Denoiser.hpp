@@ -0,0 +1,52 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+class ThreadPool;
+
+/** @brief Per-pixel inputs of the Denoiser, in row-major order */
+struct DenoiserInput
+{
+	std::vector<glm::vec3> color;		// noisy estimate of the radiance, linear HDR
+	std::vector<float> variance;		// variance of the luminance of the estimate (of the mean, not of a single sample)
+
+	// First-hit auxiliary buffers (see AuxiliarySample), averaged over the samples of each pixel
+	std::vector<glm::vec3> albedo;
+	std::vector<glm::vec3> normal;
+	std::vector<float> depth;
+};
+
+/**
+ * @brief
+ * Edge-avoiding a-trous wavelet filter (Dammertz et al., "Edge-Avoiding A-Trous Wavelet Transform for fast Global
+ * Illumination Filtering", 2010), with the variance-guided color weight of Schied et al., "Spatiotemporal
+ * Variance-Guided Filtering", 2017, without the temporal part.
+ *
+ * Each iteration is a 5x5 B3-spline blur whose taps are 2^i pixels apart: after a few iterations the footprint is large,
+ * at the cost of 25 taps per pixel and iteration. Every tap is weighted by how much its pixel looks like the center:
+ *	- normal and depth: the first hits of the two pixels lie on the same surface, so blurring does not cross geometric edges;
+ *	- luminance: the difference is compared to the noise the two estimates have (their variance), so real features
+ *		such as shadow boundaries are kept while differences due to noise are smoothed. The variance is filtered
+ *		along with the color, so the tolerance shrinks as the image gets smoother.
+ * The color is divided by the albedo before filtering and multiplied back after, so textures stay sharp:
+ * only the illumination is blurred.
+ *
+ * The filter runs on planar float buffers, simd_width pixels of a row at a time (see Simd.hpp), and the rows are
+ * shared between the threads of a ThreadPool.
+ */
+class Denoiser
+{
+public:
+	Denoiser() = default;
+	~Denoiser() = default;
+
+	uint32_t iterations = 5;				// taps up to 2^(iterations - 1) pixels apart
+	float color_sigma = 4.f;				// tolerance on luminance differences, in standard deviations of the noise
+	float normal_sigma = 128.f;			// sharpness of the normal weight, exp(-normal_sigma * (1 - cos))
+	float depth_sigma = 1.f;				// tolerance on depth differences, relative to the depth gradient of the center pixel
+
+	/** @brief Filtered color of an image of the given resolution, computed on the threads of thread_pool */
+	std::vector<glm::vec3> denoise(const glm::uvec2& resolution, const DenoiserInput& input, ThreadPool& thread_pool) const;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <limits>
+#include <utility>
+#include <glm/glm.hpp>
+
+/**
+ * @brief
+ * An axis-aligned bounding box is the region of space enclosed between two corners, min and max,
+ * whose faces are parallel to the world axes.
+ * It is the standard bounding volume for ray tracing acceleration structures because the ray-box test
+ * reduces to clipping the ray against three pairs of parallel planes, called slabs.
+ *
+ * For each axis i, the ray p(t) = r0 + t*d enters and leaves the slab at:
+ * t0_i = (min_i - r0_i) / d_i
+ * t1_i = (max_i - r0_i) / d_i
+ * The ray overlaps the box when the largest entry distance is smaller than the smallest exit distance.
+ */
+struct AABB
+{
+	AABB() :
+		min{ std::numeric_limits<float>::infinity() },
+		max{ -std::numeric_limits<float>::infinity() }
+	{}
+	AABB(const glm::vec3& min, const glm::vec3& max) :
+		min{ min },
+		max{ max }
+	{}
+
+	glm::vec3 min;
+	glm::vec3 max;
+
+	bool isEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+	glm::vec3 getCentroid() const { return (min + max) * 0.5f; }
+	glm::vec3 getExtent() const { return max - min; }
+
+	/** @brief Total area of the six faces, used by the surface area heuristic */
+	float getSurfaceArea() const
+	{
+		if (isEmpty())
+			return 0.f;
+		auto e = getExtent();
+		return 2.f * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+
+	/** @brief Index of the axis with the largest extent */
+	int getLongestAxis() const
+	{
+		auto e = getExtent();
+		if (e.x > e.y && e.x > e.z)
+			return 0;
+		return e.y > e.z ? 1 : 2;
+	}
+
+	void expand(const glm::vec3& p)
+	{
+		min = glm::min(min, p);
+		max = glm::max(max, p);
+	}
+	void expand(const AABB& other)
+	{
+		min = glm::min(min, other.min);
+		max = glm::max(max, other.max);
+	}
+
+	/**
+	 * @brief Slab test against a ray given its origin and the reciprocal of its direction.
+	 * The far distance is slightly enlarged to stay conservative under floating point rounding.
+	 */
+	bool intersect(const glm::vec3& origin,
+								 const glm::vec3& inv_direction,
+								 float t_min,
+								 float t_max) const
+	{
+		for (auto axis = 0; axis < 3; ++axis)
+		{
+			auto t0 = (min[axis] - origin[axis]) * inv_direction[axis];
+			auto t1 = (max[axis] - origin[axis]) * inv_direction[axis];
+			if (t0 > t1)
+				std::swap(t0, t1);
+			t1 *= 1.f + 2.f * 3.f * std::numeric_limits<float>::epsilon();
+			t_min = t0 > t_min ? t0 : t_min;
+			t_max = t1 < t_max ? t1 : t_max;
+			if (t_min > t_max)
+				return false;
+		}
+		return true;
+	}
+};
+
+inline AABB merge(const AABB& a, const AABB& b)
+{
+	return AABB(glm::min(a.min, b.min), glm::max(a.max, b.max));
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+
+#include "IHittableObject.hpp"
+#include "Accelerator/BVH.hpp"
+
+/**
+ * @brief
+ * A group of objects treated as a single object, with a BVH over its members.
+ * It is the building block of instancing: a prop made of several parts (e.g. spheres with different materials)
+ * is built once as a group, and every placement of the prop is an Instance referencing the same group.
+ * Each member keeps its own material; the group itself has none.
+ */
+class HittableGroup : public IHittableObject
+{
+public:
+	HittableGroup(std::vector<std::shared_ptr<IHittableObject>> objects);
+	~HittableGroup() = default;
+
+	bool intersect(const Ray& ray,
+								 float t_min,
+								 float t_max,
+								 HitRecord& hit) const override;
+
+	void computeSurfaceInteraction(const Ray& ray,
+																 HitRecord& hit) const override;
+
+	bool occludes(const Ray& ray,
+								float t_min,
+								float t_max) const override;
+
+	/** @brief return the normal of the member whose bounding box is closest to p */
+	glm::vec3 getNormal(const glm::vec3& p) const override;
+
+	/** @brief return the texture coordinates of the member whose bounding box is closest to p */
+	glm::vec2 getTextureCoordinates(const glm::vec3& p) const override;
+
+	AABB getBoundingBox() const override { return __bvh.getBounds(); }
+	uint32_t getInstanceDepth() const override { return __instance_depth; }
+
+	void collectMaterials(std::vector<const IMaterial*>& materials) const override;
+	void assignMaterialIds(const MaterialTable& materials) const override;
+
+	const auto& getObjects() const { return __objects; }
+
+private:
+	const IHittableObject* __findClosestObject(const glm::vec3& p) const;
+
+	std::vector<std::shared_ptr<IHittableObject>> __objects;
+	std::vector<const IHittableObject*> __bvh_objects; // objects in BVH leaf order
+	BVH __bvh;
+	uint32_t __instance_depth;
+};
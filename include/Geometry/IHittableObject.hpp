@@ -1,57 +1,166 @@
 #pragma once
 
 #include <memory>
+#include <vector>
+#include <cstdint>
+#include <type_traits>
 #include <glm/glm.hpp>
 #include "Material/IMaterial.hpp"
+#include "Material/MaterialTable.hpp"
+#include "AABB.hpp"
 
 class Ray;
 
+class IHittableObject;
+
+/**
+ * @brief
+ * An intersection is found in two phases. IHittableObject::intersect only records what identifies the hit:
+ * the distance, the object and the primitive that was hit, and the instances traversed to reach it.
+ * It runs for every candidate that is closer than the previous one, so it must stay cheap.
+ * The shading attributes (point, normal, texture coordinates, material) are filled in afterwards,
+ * once and for the closest hit only, by computeSurfaceInteraction.
+ *
+ * The record is a plain trivially copyable struct: the material and the objects are referenced by non-owning pointers.
+ * They are owned by the objects of the scene, which outlive any ray cast against it, and copying a record
+ * costs no reference counting (an atomic operation on a counter shared by all the threads).
+ */
 struct HitRecord
 {
-	HitRecord() : 
-		point{},
-		normal{},
-		t{},
-		tc_u{},
-		tc_v{},
-		is_ray_outside{ true },
-		material{ nullptr }
-	{}
+	/** @brief Maximum number of nested instances on the path to a primitive */
+	static constexpr auto MAX_INSTANCE_DEPTH = 4u;
+
+	/** @brief The object that resolves the surface attributes: the outermost unresolved instance, otherwise the primitive's object */
+	const IHittableObject* getNextObject() const { return instance_count > 0 ? instances[instance_count - 1] : object; }
+
+	// Surface attributes, filled in by computeSurfaceInteraction
+	glm::vec3 point{};												// Intersection point
+	glm::vec3 normal{};												// Surface normal at the hit point
+	float t{};																// Distance along the ray
+	float tc_u{};															// Texture coordinate u 
+	float tc_v{};															// Texture coordinate v 
+
+	// Hit identification, filled in by intersect
+	uint32_t primitive_id{};									// e.g. the triangle of a mesh, the sphere of a sphere set
+	glm::vec2 primitive_uv{};									// coordinates on the primitive worth keeping (e.g. barycentrics)
 
-	glm::vec3 point;												// Intersection point
-	glm::vec3 normal;												// Surface normal at the hit point
-	float tc_u;															// Texture coordinate u 
-	float tc_v;															// Texture coordinate v 
-	float t;																// Distance along the ray
-	bool is_ray_outside;
-	std::shared_ptr<IMaterial> material;
+	const IMaterial* material{ nullptr };
+	uint32_t material_id{};										// index of the material in the MaterialTable of the scene
+	uint32_t light_id{};											// index of the object in the light table of the scene, IHittableObject::NO_LIGHT if it is not a light
+	const IHittableObject* object{ nullptr };	// the object that owns the primitive (never an instance or a group)
+	const IHittableObject* instances[MAX_INSTANCE_DEPTH]{};	// instances traversed, innermost first
+	uint32_t instance_count{};
+	bool is_ray_outside{ true };
 };
+static_assert(std::is_trivially_copyable_v<HitRecord>);
 
 
+/** @brief A point sampled on the surface of an emitter, for next-event estimation */
+struct LightSample
+{
+	glm::vec3 point;
+	glm::vec3 normal;
+	glm::vec2 texture_coordinates;
+	float pdf;		// with respect to the solid angle seen from the shading point
+};
+
 class IHittableObject
 {
 public:
+	/** @brief Light id of the objects that are not in the light table of a scene */
+	static constexpr auto NO_LIGHT = UINT32_MAX;
+
 	IHittableObject(const glm::vec3& position,
 									const std::shared_ptr<IMaterial>& material) : 
 		__position{ position},
-		__material{ material }
+		__material{ material },
+		__material_id{ MaterialTable::NO_MATERIAL },
+		__light_id{ NO_LIGHT }
 	{}
 	virtual ~IHittableObject() = default;
 
+	/** 
+	 * @brief First phase: if the object is hit in [t_min, t_max], set t and identify the hit (see HitRecord).
+	 * The surface attributes are left untouched, and so is the whole record when the object is missed:
+	 * the same record can be passed to every candidate and ends up describing the closest one.
+	 */
 	virtual bool intersect(const Ray& ray,
 												 float t_min, 
 												 float t_max,
 												 HitRecord& hit) const = 0;
+
+	/** 
+	 * @brief Second phase: fill in the surface attributes of a hit found by intersect with the same ray.
+	 * Called on hit.getNextObject(); instances move the ray to their local space and pass it on.
+	 */
+	virtual void computeSurfaceInteraction(const Ray& ray,
+																				 HitRecord& hit) const = 0;
+
+	/** 
+	 * @brief Visibility test: return true if the object blocks the ray anywhere in [t_min, t_max].
+	 * Unlike intersect, it does not look for the nearest root and does not fill a HitRecord.
+	 */
+	virtual bool occludes(const Ray& ray,
+												float t_min,
+												float t_max) const = 0;
+
 	virtual glm::vec3 getNormal(const glm::vec3& p) const = 0;
 	virtual glm::vec2 getTextureCoordinates(const glm::vec3& p) const = 0;
+	
+	/** @brief return the world-space bounding box, used to build the acceleration structure */
+	virtual AABB getBoundingBox() const = 0;
+
+	/**
+	 * @brief
+	 * Sample a point of the surface towards which p can send a shadow ray (next-event estimation), from the
+	 * uniform numbers u. Return false if the surface cannot be sampled from p: it is then only reached by scattered rays.
+	 */
+	virtual bool sampleSurface(const glm::vec3& p,
+														 const glm::vec2& u,
+														 LightSample& sample) const { return false; }
+
+	/** @brief Density of sampleSurface(p, ...) producing the point q of the surface, 0 if it cannot produce it */
+	virtual float getSurfacePdf(const glm::vec3& p,
+															const glm::vec3& q) const { return 0.f; }
+
+	/** @brief Area of the surface that sampleSurface draws points from, 0 if it cannot be sampled (power of the lights) */
+	virtual float getSurfaceArea() const { return 0.f; }
+
+	/** @brief Append the materials that a hit on this object can report */
+	virtual void collectMaterials(std::vector<const IMaterial*>& materials) const
+	{
+		if (__material)
+			materials.push_back(__material.get());
+	}
+
+	/**
+	 * @brief Store the ids in the table of the materials listed by collectMaterials, so that computeSurfaceInteraction
+	 * can report HitRecord::material_id without a lookup. Called by the scene whenever the ids change.
+	 */
+	virtual void assignMaterialIds(const MaterialTable& materials) const
+	{
+		__material_id = materials.getMaterialId(__material.get());
+	}
+
+	/** @brief return the number of nested instances inside this object, at most HitRecord::MAX_INSTANCE_DEPTH */
+	virtual uint32_t getInstanceDepth() const { return 0; }
 
 	const auto& getMaterial() const { return __material; }
+	auto getMaterialId() const { return __material_id; }
+
+	/** @brief Index of the object in the light table of the scene, reported by computeSurfaceInteraction in HitRecord::light_id */
+	void setLightId(uint32_t light_id) const { __light_id = light_id; }
+	auto getLightId() const { return __light_id; }
 	const auto& getPosition() const { return __position; }
 
 
 protected:
 	glm::vec3 __position;
 	std::shared_ptr<IMaterial> __material;
+	// Id of __material in the table of the scene that contains the object. It is derived from that table, and objects
+	// shared by instances are only reached through const pointers, so it can be updated on a const object.
+	mutable uint32_t __material_id;
+	mutable uint32_t __light_id;		// set by the scene, like __material_id
 };
 
 template<typename ObjectType, typename... Args>
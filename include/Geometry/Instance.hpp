@@ -0,0 +1,69 @@
+#pragma once
+
+#include <memory>
+
+#include "IHittableObject.hpp"
+
+/**
+ * @brief
+ * A placement of a shared object in the scene.
+ * The object (typically a TriangleMesh or a HittableGroup, i.e. a bottom-level structure with its own BVH)
+ * is stored once, in its local space, and any number of instances place it in the world through a transform.
+ * The scene BVH over the instances forms the top level, so memory grows with the number of distinct objects
+ * while an instance only adds a pointer and two matrices.
+ *
+ * Rays are moved to the local space with the inverse transform instead of moving the object to the world.
+ * The local ray direction is not normalized by the transform: with d' = M^-1 d, a world distance t
+ * corresponds to the local distance t * |d'|, so the ray interval is scaled on the way in and the hit distance
+ * on the way out. Normals are transformed by the inverse transpose, which keeps them perpendicular to the
+ * surface under non-uniform scaling.
+ *
+ * intersect only pushes the instance on the hit path of the record; the transform back to the world is applied
+ * to the surface attributes in computeSurfaceInteraction, for the closest hit only.
+ */
+class Instance : public IHittableObject
+{
+public:
+	/**
+	 * @brief If material is not null, it replaces the materials of the instanced object.
+	 * Throw std::invalid_argument if the object already nests HitRecord::MAX_INSTANCE_DEPTH instances.
+	 */
+	Instance(std::shared_ptr<const IHittableObject> object,
+					 const glm::mat4& transform,
+					 const std::shared_ptr<IMaterial>& material = nullptr);
+	~Instance() = default;
+
+	bool intersect(const Ray& ray,
+								 float t_min,
+								 float t_max,
+								 HitRecord& hit) const override;
+
+	void computeSurfaceInteraction(const Ray& ray,
+																 HitRecord& hit) const override;
+
+	bool occludes(const Ray& ray,
+								float t_min,
+								float t_max) const override;
+
+	glm::vec3 getNormal(const glm::vec3& p) const override;
+	glm::vec2 getTextureCoordinates(const glm::vec3& p) const override;
+	AABB getBoundingBox() const override { return __bounds; }
+	uint32_t getInstanceDepth() const override { return __object->getInstanceDepth() + 1; }
+
+	void collectMaterials(std::vector<const IMaterial*>& materials) const override;
+	void assignMaterialIds(const MaterialTable& materials) const override;
+
+	const auto& getObject() const { return __object; }
+	const auto& getTransform() const { return __transform; }
+
+private:
+	/** @brief Ray in the local space of the object, and the ratio between local and world distances */
+	Ray __toLocalRay(const Ray& ray, float& distance_scale) const;
+
+	std::shared_ptr<const IHittableObject> __object;
+	glm::mat4 __transform;					// local to world
+	glm::mat4 __inverse_transform;	// world to local
+	glm::mat3 __normal_matrix;			// inverse transpose of the linear part of the transform
+	AABB __bounds;									// world-space bounds
+	bool __override_material;
+};
@@ -2,7 +2,7 @@
 
 #include "IHittableObject.hpp"
 
-class Plane : public IHittableObject
+class Plane final : public IHittableObject
 {
 public:
 	Plane(const glm::vec3& position,		// the plane's center.
@@ -10,12 +10,7 @@ public:
 				glm::vec3 orientation,				// the plane's normal.
 				float width,
 				float height
-	)	: 
-		IHittableObject(position, material),
-		__orientation{ orientation },
-		__width{ width },
-		__height{ height }
-	{}
+	);
 	~Plane() = default;
 
 	bool intersect(const Ray& ray,
@@ -23,14 +18,34 @@ public:
 								 float t_max,
 								 HitRecord& hit) const override;
 
+	void computeSurfaceInteraction(const Ray& ray,
+																 HitRecord& hit) const override;
+
+	bool occludes(const Ray& ray,
+								float t_min,
+								float t_max) const override;
+
 	/** @brief return the normal vector */
 	glm::vec3 getNormal(const glm::vec3& p) const override { return __orientation; }
 
 	/** @brief return the local, unnormalized (u, v) coordinates */
 	glm::vec2 getTextureCoordinates(const glm::vec3& p) const override;
 
+	AABB getBoundingBox() const override;
+
+	bool sampleSurface(const glm::vec3& p,
+										 const glm::vec2& u,
+										 LightSample& sample) const override;
+
+	float getSurfacePdf(const glm::vec3& p,
+											const glm::vec3& q) const override;
+
+	float getSurfaceArea() const override { return __width * __height; }
+
 private:
 	glm::vec3 __orientation;
+	glm::vec3 __tangent;		// local u axis on the plane
+	glm::vec3 __bitangent;	// local v axis on the plane
 	float __width;
 	float __height;
 };
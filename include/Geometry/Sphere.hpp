@@ -2,7 +2,7 @@
 
 #include "IHittableObject.hpp"
 
-class Sphere : public IHittableObject
+class Sphere final : public IHittableObject
 {
 public:
 	Sphere(const glm::vec3& position, // the center of the sphere
@@ -17,14 +17,35 @@ public:
 								 float t_min,
 								 float t_max,
 								 HitRecord& hit) const override;
+
+	void computeSurfaceInteraction(const Ray& ray,
+																 HitRecord& hit) const override;
+
+	bool occludes(const Ray& ray,
+								float t_min,
+								float t_max) const override;
 	
 	/** @brief return the normal vector */
 	glm::vec3 getNormal(const glm::vec3& p) const override;
 
 	glm::vec2 getTextureCoordinates(const glm::vec3& p) const override;
 
+	AABB getBoundingBox() const override;
+
+	bool sampleSurface(const glm::vec3& p,
+										 const glm::vec2& u,
+										 LightSample& sample) const override;
+
+	float getSurfacePdf(const glm::vec3& p,
+											const glm::vec3& q) const override;
+
+	float getSurfaceArea() const override { return 4.f * glm::pi<float>() * __radius * __radius; }
+
 	auto getRadius() const { return __radius; }
 
 private:
+	/** @brief 1 / solid angle of the cone under which the sphere is seen from p, 0 if p is inside the sphere */
+	float __computeConePdf(const glm::vec3& p, float& one_minus_cos_theta_max) const;
+
 	float __radius;
 };
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "IHittableObject.hpp"
+#include "Accelerator/BVH.hpp"
+
+/**
+ * @brief
+ * A large set of spheres sharing one material, for particle-like scenes.
+ * Adding thousands of Sphere objects to the scene makes every test a virtual call on a separate heap object.
+ * Here the spheres are a single object, with a BVH over them and their data stored as a structure of arrays:
+ * the x, y and z of the centers and the radii live in four separate arrays, in BVH leaf order.
+ * A leaf then holds contiguous values that map directly onto SIMD registers, and its spheres are tested
+ * against the ray in one go: 8 at a time with AVX, 4 with SSE, one at a time otherwise.
+ * Only the distance and the index of the closest sphere come out of the SIMD kernel; the normal and
+ * the texture coordinates are computed once, for that sphere only.
+ */
+class SphereSet : public IHittableObject
+{
+public:
+	SphereSet(const std::vector<glm::vec3>& centers,
+						const std::vector<float>& radii,
+						const std::shared_ptr<IMaterial>& material);
+	~SphereSet() = default;
+
+	bool intersect(const Ray& ray,
+								 float t_min,
+								 float t_max,
+								 HitRecord& hit) const override;
+
+	void computeSurfaceInteraction(const Ray& ray,
+																 HitRecord& hit) const override;
+
+	bool occludes(const Ray& ray,
+								float t_min,
+								float t_max) const override;
+
+	/** @brief return the normal of the sphere whose surface is closest to p */
+	glm::vec3 getNormal(const glm::vec3& p) const override;
+
+	/** @brief return the spherical texture coordinates on the sphere whose surface is closest to p */
+	glm::vec2 getTextureCoordinates(const glm::vec3& p) const override;
+
+	AABB getBoundingBox() const override { return __bvh.getBounds(); }
+
+	auto getSphereCount() const { return static_cast<uint32_t>(__bvh.getPrimitiveIndices().size()); }
+
+	/** @brief Number of spheres tested together by the intersection kernel */
+	static uint32_t getSimdWidth();
+
+	/** @brief Closest sphere hit by the ray in [t_min, t_max]: its index in the input arrays and its distance */
+	bool intersectClosest(const Ray& ray,
+												float t_min,
+												float t_max,
+												uint32_t& sphere_index,
+												float& t) const;
+
+private:
+	uint32_t __findClosestSlot(const glm::vec3& p) const;
+	glm::vec2 __computeTextureCoordinates(uint32_t slot, const glm::vec3& p) const;
+
+	// Structure of arrays in BVH leaf order, padded so that a full SIMD load past the last leaf stays in bounds
+	std::vector<float> __center_x;
+	std::vector<float> __center_y;
+	std::vector<float> __center_z;
+	std::vector<float> __radius;
+	BVH __bvh;
+};
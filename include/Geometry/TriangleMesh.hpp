@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <memory>
+#include <cstdint>
+
+#include "IHittableObject.hpp"
+#include "Accelerator/BVH.hpp"
+
+/**
+ * @brief
+ * Vertex and index buffers of a triangle mesh.
+ * Attributes are stored per vertex: normals and texture coordinates are optional, but when present
+ * they have one entry per position. Each triangle references its three vertices by index.
+ */
+struct MeshBuffers
+{
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec2> texture_coordinates;
+	std::vector<glm::uvec3> triangles;
+};
+
+/**
+ * @brief
+ * Read-only view of a mesh and of the BVH over its triangles.
+ * The arrays are not necessarily owned by the process heap: they can point straight into a memory-mapped
+ * mesh cache, in which case storage keeps the mapping alive. Either way the data is immutable once created.
+ */
+struct MeshData
+{
+	std::span<const glm::vec3> positions;
+	std::span<const glm::vec3> normals;
+	std::span<const glm::vec2> texture_coordinates;
+	std::span<const glm::uvec3> triangles;
+	BVH bvh;
+	std::shared_ptr<const void> storage;	// owner of the memory referenced by the spans
+};
+
+/** @brief Take ownership of the buffers and build the BVH over the triangles */
+std::shared_ptr<MeshData> createMeshData(MeshBuffers&& buffers);
+
+/**
+ * @brief
+ * A triangle mesh is a single scene object, however many triangles it has: it is traversed with the BVH
+ * over its own triangles, and the scene BVH only sees the bounding box of the whole mesh.
+ * The vertex data and the BVH are shared, so several meshes (e.g. with different materials) can use the same buffers.
+ *
+ * Triangles are intersected with the watertight algorithm of Woop, Benthin and Wald
+ * ("Watertight Ray/Triangle Intersection", JCGT 2013). The triangle is moved into a coordinate system
+ * where the ray starts at the origin and points along +z, and the hit test reduces to the signs of three
+ * 2D edge functions. An edge shared by two triangles is evaluated with exactly the same operations from both sides,
+ * so a ray that passes through the edge cannot slip between them, as it can with the Möller-Trumbore test.
+ */
+class TriangleMesh : public IHittableObject
+{
+public:
+	TriangleMesh(std::shared_ptr<const MeshData> mesh_data,
+							 const std::shared_ptr<IMaterial>& material);
+	~TriangleMesh() = default;
+
+	bool intersect(const Ray& ray,
+								 float t_min,
+								 float t_max,
+								 HitRecord& hit) const override;
+
+	void computeSurfaceInteraction(const Ray& ray,
+																 HitRecord& hit) const override;
+
+	bool occludes(const Ray& ray,
+								float t_min,
+								float t_max) const override;
+
+	/** @brief return the normal of the surface point closest to p */
+	glm::vec3 getNormal(const glm::vec3& p) const override;
+
+	/** @brief return the texture coordinates of the surface point closest to p */
+	glm::vec2 getTextureCoordinates(const glm::vec3& p) const override;
+
+	AABB getBoundingBox() const override { return __bvh.getBounds(); }
+
+	const auto& getMeshData() const { return __mesh_data; }
+	auto getTriangleCount() const { return static_cast<uint32_t>(__mesh_data->triangles.size()); }
+
+private:
+	/** @brief Find the triangle closest to p, and the barycentric coordinates of the closest point on it */
+	uint32_t __findClosestTriangle(const glm::vec3& p, glm::vec3& barycentric) const;
+
+	glm::vec3 __computeGeometricNormal(uint32_t triangle) const;
+	glm::vec3 __interpolateNormal(uint32_t triangle, const glm::vec3& barycentric) const;
+	glm::vec2 __interpolateTextureCoordinates(uint32_t triangle, const glm::vec3& barycentric) const;
+
+	std::shared_ptr<const MeshData> __mesh_data;
+	BVH __bvh;
+};
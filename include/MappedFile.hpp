@@ -0,0 +1,38 @@
+#pragma once
+
+#include <filesystem>
+#include <cstddef>
+
+/**
+ * @brief
+ * Read-only memory mapping of a whole file.
+ * The operating system loads the pages lazily when they are first accessed, so opening a file costs
+ * the same whatever its size, and its content is used in place without being parsed or copied.
+ * Pages are shared through the file system cache, so the same file mapped by several processes occupies memory once.
+ */
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/** @brief Map the file, return false if it cannot be opened or mapped */
+	bool open(const std::filesystem::path& file_path);
+	void close();
+
+	bool isOpen() const { return __data != nullptr; }
+	const std::byte* getData() const { return __data; }
+	size_t getSize() const { return __size; }
+
+private:
+	const std::byte* __data = nullptr;
+	size_t __size = 0;
+
+#ifdef _WIN32
+	void* __file_handle = nullptr;
+	void* __mapping_handle = nullptr;
+#endif
+};
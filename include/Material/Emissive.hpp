@@ -19,8 +19,14 @@ public:
 
   bool scatter(const Ray& incident,
                const HitRecord& hit,
+               const glm::vec2& u,
                glm::vec3& surface_color,
                Ray& scattered_ray) const override { return false; }
 
-  glm::vec3 emitted(float u, float v) const override;
+  glm::vec3 emitted(float u, float v) const override { return emitted(getRecord(), u, v); }
+
+  MaterialType getType() const override { return MaterialType::EMISSIVE; }
+
+  /** @brief The emission of an emissive material, evaluated on its record */
+  static glm::vec3 emitted(const MaterialRecord& material, float u, float v);
 };
\ No newline at end of file
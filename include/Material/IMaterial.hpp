@@ -2,6 +2,7 @@
 
 #include <glm/glm.hpp>
 #include <memory>
+#include <cstdint>
 
 #include "Texture/Texture2D.hpp"
 
@@ -46,6 +47,32 @@ class Ray;
  * ]
  */
 
+/** @brief Concrete material types, the tag of a MaterialRecord */
+enum class MaterialType : uint32_t
+{
+	MATTE,
+	METAL,
+	EMISSIVE,
+};
+
+/**
+ * @brief
+ * Plain copy of the parameters of a material, tagged with its type.
+ * The textures are referenced by non-owning pointers: they are owned by the material the record is made from.
+ * Records are what the renderer evaluates, through a switch on the type (see MaterialTable), so shading needs
+ * neither virtual calls nor RTTI.
+ */
+struct MaterialRecord
+{
+	MaterialType type;
+	float roughness_scale;
+	glm::vec3 color_scale;
+	glm::vec3 emission_scale;
+	const Texture2D* color_texture;
+	const Texture2D* roughness_texture;
+	const Texture2D* emission_texture;
+};
+
 class IMaterial
 {
 public:
@@ -68,13 +95,33 @@ public:
 	std::shared_ptr<Texture2D> roughness_texture;
 	std::shared_ptr<Texture2D> emission_texture;
 
-	/** @brief Determines how an incoming ray interacts with the surface, how it bounces off. */
+	/**
+	 * @brief Determines how an incoming ray interacts with the surface, how it bounces off.
+	 * The random choices of the bounce are made with the uniform numbers u, two dimensions of the path sample (see ISampler).
+	 */
 	virtual bool scatter(const Ray& incident,
 											 const HitRecord& hit,
+											 const glm::vec2& u,
 											 glm::vec3& surface_color,
 											 Ray& scattered_ray) const = 0;
 	
 	virtual glm::vec3 emitted(float u, float v) const { return glm::vec3(0.f); }
+
+	virtual MaterialType getType() const = 0;
+
+	/** @brief Snapshot of the current parameters */
+	MaterialRecord getRecord() const
+	{
+		return MaterialRecord{
+			getType(),
+			roughness_scale,
+			color_scale,
+			emission_scale,
+			color_texture.get(),
+			roughness_texture.get(),
+			emission_texture.get()
+		};
+	}
 };
 
 template<typename MaterialType, typename... Args>
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "IMaterial.hpp"
+#include "Metal.hpp"
+
+/**
+ * @brief
+ * Flat table of the materials of a scene, as MaterialRecord values sorted by type.
+ * A material is evaluated by a switch on the type of its record, which calls the static kernel of the
+ * concrete class (Matte::scatter, Metal::scatter, Emissive::emitted): there is no virtual call and no RTTI
+ * on the shading path. Since the records are sorted, materials of the same type have neighbouring ids, and
+ * work sorted by material id is also sorted by type.
+ *
+ * The table is filled with the materials of the objects as they are added to the scene, and refreshed by
+ * build(), which takes the current parameters of the materials and sorts them.
+ *
+ * The shading functions also accept NO_MATERIAL, for hits on objects without a material: such a surface is black,
+ * it neither emits nor scatters, so the path ends there.
+ */
+class MaterialTable
+{
+public:
+	/** @brief Id of the objects without a material (e.g. geometry only used for queries) */
+	static constexpr auto NO_MATERIAL = UINT32_MAX;
+
+	MaterialTable() = default;
+	~MaterialTable() = default;
+
+	/** @brief Append the materials not yet in the table */
+	void add(const std::vector<const IMaterial*>& materials);
+	void clear();
+
+	/** @brief Update the records from their materials and sort them by type; this changes the ids */
+	void build();
+
+	/** @brief Id of a material of the table, NO_MATERIAL if it is not in the table */
+	uint32_t getMaterialId(const IMaterial* material) const
+	{
+		auto it = __ids.find(material);
+		return it != __ids.end() ? it->second : NO_MATERIAL;
+	}
+
+	/** @brief Record of a material of the table; material_id must not be NO_MATERIAL */
+	const auto& getMaterial(uint32_t material_id) const { return __records[material_id]; }
+	auto getMaterialCount() const { return static_cast<uint32_t>(__records.size()); }
+
+	/** @brief IMaterial::scatter on the material with the given id */
+	bool scatter(uint32_t material_id,
+							 const Ray& incident,
+							 const HitRecord& hit,
+							 const glm::vec2& u,
+							 glm::vec3& surface_color,
+							 Ray& scattered_ray) const;
+
+	/** @brief IMaterial::emitted on the material with the given id */
+	glm::vec3 emitted(uint32_t material_id, float u, float v) const;
+
+	/**
+	 * @brief
+	 * True if scatter picks its direction from a (near) delta distribution, such as a polished metal:
+	 * light sampling cannot reach such directions, so they are only followed by scatter.
+	 * Rough metals are glossy, not specular: they get light sampling and MIS like matte surfaces.
+	 */
+	bool isSpecular(uint32_t material_id) const
+	{
+		if (material_id == NO_MATERIAL)
+			return false;
+		const auto& material = __records[material_id];
+		return material.type == MaterialType::METAL && material.roughness_scale < Metal::SPECULAR_ROUGHNESS;
+	}
+
+	/**
+	 * @brief
+	 * True for the rough metals: scatter may send their microfacet reflection below the surface, which ends the
+	 * path, but the light they reflect from light sampling is still there and must be added all the same.
+	 */
+	bool isGlossy(uint32_t material_id) const
+	{
+		if (material_id == NO_MATERIAL)
+			return false;
+		const auto& material = __records[material_id];
+		return material.type == MaterialType::METAL && material.roughness_scale >= Metal::SPECULAR_ROUGHNESS;
+	}
+
+	/**
+	 * @brief BSDF times cosine for light arriving from direction and leaving towards outgoing (unit vectors away
+	 * from the surface), for a non-specular material
+	 */
+	glm::vec3 evaluate(uint32_t material_id, const HitRecord& hit, const glm::vec3& outgoing, const glm::vec3& direction) const;
+
+	/** @brief Color of the surface at the hit, to separate it from the illumination (see Denoiser); 1 for lights */
+	glm::vec3 albedo(uint32_t material_id, const HitRecord& hit) const;
+
+	/** @brief Density (per unit solid angle) with which scatter picks direction from outgoing, for a non-specular material */
+	float pdf(uint32_t material_id, const HitRecord& hit, const glm::vec3& outgoing, const glm::vec3& direction) const;
+
+private:
+	std::vector<MaterialRecord> __records;
+	std::vector<const IMaterial*> __materials;		// the source of each record
+	std::unordered_map<const IMaterial*, uint32_t> __ids;
+};
@@ -23,6 +23,26 @@ public:
 	 */
 	bool scatter(const Ray& incident,
 							 const HitRecord& hit,
+							 const glm::vec2& u,
 							 glm::vec3& surface_color,
-							 Ray& scattered_ray) const override;
+							 Ray& scattered_ray) const override { return scatter(getRecord(), incident, hit, u, surface_color, scattered_ray); }
+
+	MaterialType getType() const override { return MaterialType::MATTE; }
+
+	/** @brief The scattering of a matte material, evaluated on its record */
+	static bool scatter(const MaterialRecord& material,
+											const Ray& incident,
+											const HitRecord& hit,
+											const glm::vec2& u,
+											glm::vec3& surface_color,
+											Ray& scattered_ray);
+
+	/** @brief BSDF times cosine for the (normalized) direction: albedo * cos(theta) / pi */
+	static glm::vec3 evaluate(const MaterialRecord& material,
+														const HitRecord& hit,
+														const glm::vec3& direction);
+
+	/** @brief Density of the directions chosen by scatter: cos(theta) / pi */
+	static float pdf(const HitRecord& hit,
+									 const glm::vec3& direction);
 };
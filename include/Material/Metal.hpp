@@ -5,6 +5,9 @@
 class Metal : public IMaterial
 {
 public:
+	/** @brief Below this roughness the reflection is treated as a mirror: it is not reached by light sampling */
+	static constexpr float SPECULAR_ROUGHNESS = 0.05f;
+
 	Metal(glm::vec3 color_scale, 
 				float roughness_scale,
 				std::shared_ptr<Texture2D> roughness_texture) : IMaterial()
@@ -32,6 +35,29 @@ public:
 	 */
 	bool scatter(const Ray& incident,
 							 const HitRecord& hit,
+							 const glm::vec2& u,
 							 glm::vec3& surface_color,
-							 Ray& scattered_ray) const override;
+							 Ray& scattered_ray) const override { return scatter(getRecord(), incident, hit, u, surface_color, scattered_ray); }
+
+	MaterialType getType() const override { return MaterialType::METAL; }
+
+	/** @brief The scattering of a metal material, evaluated on its record */
+	static bool scatter(const MaterialRecord& material,
+											const Ray& incident,
+											const HitRecord& hit,
+											const glm::vec2& u,
+											glm::vec3& surface_color,
+											Ray& scattered_ray);
+
+	/** @brief BRDF times cosine for light arriving from direction and leaving towards outgoing (unit vectors away from the surface) */
+	static glm::vec3 evaluate(const MaterialRecord& material,
+														const HitRecord& hit,
+														const glm::vec3& outgoing,
+														const glm::vec3& direction);
+
+	/** @brief Density with which scatter reflects the outgoing direction to direction: D(m) |n.m| / (4 |o.m|) */
+	static float pdf(const MaterialRecord& material,
+									 const HitRecord& hit,
+									 const glm::vec3& outgoing,
+									 const glm::vec3& direction);
 };
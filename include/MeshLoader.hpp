@@ -0,0 +1,33 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+
+#include "Geometry/TriangleMesh.hpp"
+
+namespace MeshLoader
+{
+	using path = std::filesystem::path;
+
+	/**
+	 * @brief Load the geometry of a Wavefront OBJ file: positions, normals and texture coordinates.
+	 * Polygons are triangulated as fans, and every distinct position/texture/normal combination becomes one vertex.
+	 * Materials, groups and smoothing groups are ignored. Return nullptr if the file cannot be read.
+	 *
+	 * With use_cache, the mesh is read from "<file_path>.rtmesh" when this cache is up to date with the OBJ file;
+	 * otherwise the OBJ file is parsed and the cache is written for the next time.
+	 */
+	std::shared_ptr<MeshData> loadOBJ(const path& file_path, bool use_cache = true);
+
+	/**
+	 * @brief
+	 * The mesh cache is a binary file holding the vertex attributes, the triangles and the BVH, laid out exactly
+	 * as they are in memory, each array aligned to a cache line. Loading maps the file and points the mesh spans
+	 * straight into it: nothing is parsed or copied, and the pages are read from disk only when first touched.
+	 * The file uses the byte order and the layout of the machine that wrote it.
+	 *
+	 * If source_path is given, the cache is rejected when it was not written from the current version of that file.
+	 */
+	std::shared_ptr<MeshData> loadMeshCache(const path& cache_path, const path& source_path = {});
+	bool writeMeshCache(const path& cache_path, const MeshData& mesh, const path& source_path = {});
+}
@@ -6,6 +6,39 @@
 
 class Scene;
 class Ray;
+class ISampler;
+
+/** @brief Lights sampled at each vertex of a path (next-event estimation) */
+enum class LightSelection
+{
+	ALL,		// every light, one shadow ray each
+	POWER,	// a single light, chosen in proportion to its power (Scene::getLightDistribution): one shadow ray whatever the number of lights
+};
+
+/**
+ * @brief
+ * Power heuristic (beta = 2) of Veach's multiple importance sampling: weight of a sample drawn with density
+ * pdf_a, when the same direction could also have been drawn by a second technique with density pdf_b.
+ */
+inline float powerHeuristic(float pdf_a, float pdf_b)
+{
+	auto a2 = pdf_a * pdf_a;
+	auto b2 = pdf_b * pdf_b;
+	return a2 + b2 > 0.f ? a2 / (a2 + b2) : 0.f;
+}
+
+/**
+ * @brief
+ * Auxiliary outputs (AOVs) of a camera ray, taken at its first hit: they guide the Denoiser.
+ * Specular surfaces are seen through: the AOVs are those of the first non-specular hit, with the albedo tinted
+ * by the specular bounces, so that the edges of reflected objects are kept.
+ */
+struct AuxiliarySample
+{
+	glm::vec3 albedo{ 0.f };		// color of the surface (1 for lights), 0 if the path leaves the scene first
+	glm::vec3 normal{ 0.f };		// 0 if the path leaves the scene first
+	float depth = 0.f;					// length of the path up to the hit, 0 if the path leaves the scene first
+};
 
 class Renderer
 {
@@ -13,7 +46,68 @@ public:
 	Renderer() = default;
 	~Renderer() = default;
 
+	/**
+	 * @brief Estimate the radiance carried back along the ray with an iterative path tracer.
+	 * Paths are cut after max_depth bounces; from russian_roulette_depth on, they are terminated
+	 * stochastically according to their throughput.
+	 * The random decisions take the next dimensions of the current sample of sampler.
+	 * If auxiliary is not null, it receives the AOVs of the path.
+	 */
 	glm::vec3 computeRayColor(const Ray& ray, 
 														const Scene& scene, 
-														uint32_t depth) const;
+														ISampler& sampler,
+														uint32_t max_depth,
+														uint32_t russian_roulette_depth,
+														LightSelection light_selection = LightSelection::ALL,
+														AuxiliarySample* auxiliary = nullptr) const;
+
+	/** @brief AOVs of a path at its first non-specular hit, reached through specular bounces of color specular_albedo */
+	static AuxiliarySample computeAuxiliarySample(const Scene& scene,
+																								const HitRecord& hit,
+																								const glm::vec3& specular_albedo,
+																								float distance);
+
+	/** @brief Number of lights sampled at each vertex */
+	static uint32_t getLightSampleCount(const Scene& scene, LightSelection light_selection);
+
+	/** @brief Dimensions of the sample taken by the light samples of a vertex: the choice of each light (by power), then the point on it */
+	static uint32_t getLightSamplingDimensions(const Scene& scene, LightSelection light_selection);
+
+	/** @brief The light of the index-th light sample, and the probability with which it is chosen */
+	static uint32_t selectLight(const Scene& scene,
+															LightSelection light_selection,
+															uint32_t index,
+															ISampler& sampler,
+															float& selection_pmf);
+
+	/**
+	 * @brief
+	 * Next-event estimation towards one light, without the visibility: sample a point of the light from the hit
+	 * with u, and compute its MIS-weighted contribution f * cos * Le * w / pdf towards outgoing (the unit vector back
+	 * along the incident ray), where pdf includes the probability selection_pmf with which the light was chosen.
+	 * The shadow ray goes from hit.point along direction, up to shadow_distance, which stops just before the light
+	 * so that it does not occlude itself. Return false if the sample brings no light.
+	 * Shared by Renderer and WavefrontRenderer, so that both compute the same estimate.
+	 */
+	static bool sampleLight(const Scene& scene,
+													uint32_t light_id,
+													float selection_pmf,
+													const HitRecord& hit,
+													const glm::vec3& outgoing,
+													const glm::vec2& u,
+													glm::vec3& direction,
+													float& shadow_distance,
+													glm::vec3& contribution);
+
+	/**
+	 * @brief
+	 * MIS weight of the light found by a ray leaving origin, that was scattered with density bsdf_pdf
+	 * (0 for camera rays and specular bounces, which light sampling cannot produce).
+	 */
+	static float computeEmissionWeight(const Scene& scene,
+																		 LightSelection light_selection,
+																		 uint32_t light_id,
+																		 const glm::vec3& origin,
+																		 const glm::vec3& point,
+																		 float bsdf_pdf);
 };
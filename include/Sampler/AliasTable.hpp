@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <cstdint>
+
+/**
+ * @brief
+ * Discrete distribution over n items, proportional to their weights, sampled in constant time with Walker's
+ * alias method (Vose's construction, "A Linear Algorithm for Generating Random Numbers with a Given Distribution", 1991).
+ * The probabilities are spread over n bins of equal probability 1/n. Each bin holds at most two items:
+ * its own, kept with probability q, and an alias, which takes the rest of the bin.
+ * Sampling picks a bin with the integer part of u * n and chooses between the two items with its fractional part,
+ * whatever the number of items.
+ */
+class AliasTable
+{
+public:
+	AliasTable() = default;
+	~AliasTable() = default;
+
+	/** @brief Build the table; if all the weights are 0 (or negative), the items are chosen uniformly */
+	void build(std::span<const float> weights);
+	void clear() { __bins.clear(); }
+
+	/** @brief Draw an item from a uniform number in [0, 1), and return the probability with which it is chosen */
+	uint32_t sample(float u, float& pmf) const
+	{
+		auto count = static_cast<uint32_t>(__bins.size());
+		auto scaled = u * static_cast<float>(count);
+		auto index = scaled < static_cast<float>(count) ? static_cast<uint32_t>(scaled) : count - 1u;
+		const auto& bin = __bins[index];
+		auto chosen = scaled - static_cast<float>(index) < bin.probability ? index : bin.alias;
+		pmf = __bins[chosen].pmf;
+		return chosen;
+	}
+
+	/** @brief Probability with which sample chooses the item */
+	float getPmf(uint32_t index) const { return __bins[index].pmf; }
+	auto size() const { return static_cast<uint32_t>(__bins.size()); }
+	bool empty() const { return __bins.empty(); }
+
+private:
+	struct Bin
+	{
+		float probability;	// of keeping the item of the bin rather than its alias
+		uint32_t alias;
+		float pmf;					// of the item of the bin, over the whole table
+	};
+
+	std::vector<Bin> __bins;
+};
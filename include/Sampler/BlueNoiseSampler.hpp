@@ -0,0 +1,33 @@
+#pragma once
+
+#include "ISampler.hpp"
+
+/**
+ * @brief
+ * Blue-noise dithered sampling (Georgiev and Fajardo, "Blue-noise Dithered Sampling", 2016).
+ * Every pixel uses the same scrambled Sobol points (see SobolSampler), shifted modulo 1 by an offset read from
+ * a blue-noise mask (a Cranley-Patterson rotation). Neighbouring pixels get offsets that are far apart,
+ * so their errors are negatively correlated: the noise of the image has no low frequencies and looks much finer
+ * than white noise. The shift breaks the stratification of the Sobol points, so the error of each pixel is higher than
+ * with SobolSampler (still well below independent samples): this sampler is meant for low sample counts,
+ * where the structure of the noise matters more than its amplitude.
+ * Each dimension reads the mask at a different, fixed position.
+ * The mask is a 64x64 tile built once with the void-and-cluster method (Ulichney, 1993).
+ */
+class BlueNoiseSampler : public ISampler
+{
+public:
+	BlueNoiseSampler(uint64_t seed = 0u);
+	~BlueNoiseSampler() = default;
+
+	float compute1D(const glm::uvec2& pixel, uint32_t sample_index, uint32_t dimension) const override;
+	glm::vec2 compute2D(const glm::uvec2& pixel, uint32_t sample_index, uint32_t dimension) const override;
+
+	std::unique_ptr<ISampler> clone() const override { return std::make_unique<BlueNoiseSampler>(*this); }
+
+private:
+	/** @brief Value of the mask at pixel, with the tile moved by an offset taken from the bits of offset_seed */
+	float __getShift(const glm::uvec2& pixel, uint32_t offset_seed) const;
+
+	const float* __mask;	// shared by all the samplers
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <memory>
+#include <cstdint>
+
+/**
+ * @brief
+ * Source of the numbers that drive the random decisions of a path.
+ * The decisions of a path sample (the position in the pixel and on the lens, then at each bounce the direction of the BSDF,
+ * the light to sample, the point on the light, Russian roulette) are the successive dimensions of one point
+ * of the unit hypercube, and the samples of a pixel are a set of such points. Every bounce takes the same number of
+ * dimensions, whether or not it makes all its decisions (a specular surface samples no light, Russian roulette only
+ * starts after a few bounces): a given dimension always drives the same decision at the same depth, in every sample.
+ * Independent uniform numbers place these points at random: the error only decreases as 1 / sqrt(n).
+ * Stratified and low-discrepancy points cover the hypercube more evenly, so the same error is reached with fewer
+ * samples, and the error can also be spread between pixels as blue noise, which is less visible.
+ *
+ * Every value is a function of the pixel, the sample index, the dimension and the seed only (compute1D, compute2D):
+ * the image does not depend on the threads, and any path can be resumed at any dimension (see WavefrontRenderer).
+ * startPixelSample/get1D/get2D walk through the dimensions of one sample; they modify the sampler,
+ * so each thread works with its own copy (clone).
+ */
+class ISampler
+{
+public:
+	/** @brief Dimensions taken by the camera ray (position in the pixel, then on the lens), the first ones of every sample */
+	static constexpr auto CAMERA_DIMENSIONS = 4u;
+
+	ISampler(uint64_t seed) : __seed{ seed } {}
+	virtual ~ISampler() = default;
+
+	/** @brief Go to the given dimension of sample sample_index of pixel */
+	void startPixelSample(const glm::uvec2& pixel, uint32_t sample_index, uint32_t dimension = 0u)
+	{
+		__pixel = pixel;
+		__sample_index = sample_index;
+		__dimension = dimension;
+	}
+
+	/** @brief Next dimension of the current sample, in [0, 1) */
+	float get1D() { return compute1D(__pixel, __sample_index, __dimension++); }
+
+	/** @brief Next two dimensions of the current sample, in [0, 1)^2, stratified together */
+	glm::vec2 get2D()
+	{
+		auto u = compute2D(__pixel, __sample_index, __dimension);
+		__dimension += 2u;
+		return u;
+	}
+
+	/** @brief Skip the next count dimensions of the current sample, those of decisions that are not taken */
+	void skipDimensions(uint32_t count) { __dimension += count; }
+
+	auto getDimension() const { return __dimension; }
+
+	virtual float compute1D(const glm::uvec2& pixel, uint32_t sample_index, uint32_t dimension) const = 0;
+	virtual glm::vec2 compute2D(const glm::uvec2& pixel, uint32_t sample_index, uint32_t dimension) const = 0;
+
+	/** @brief Copy of the sampler, for another thread */
+	virtual std::unique_ptr<ISampler> clone() const = 0;
+
+protected:
+	uint64_t __seed;
+
+private:
+	glm::uvec2 __pixel = glm::uvec2(0u);
+	uint32_t __sample_index = 0u;
+	uint32_t __dimension = 0u;
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "ISampler.hpp"
+
+/** @brief Independent uniform numbers: every dimension of every sample is a hash of its coordinates */
+class IndependentSampler : public ISampler
+{
+public:
+	IndependentSampler(uint64_t seed = 0u) : ISampler(seed) {}
+	~IndependentSampler() = default;
+
+	float compute1D(const glm::uvec2& pixel, uint32_t sample_index, uint32_t dimension) const override;
+	glm::vec2 compute2D(const glm::uvec2& pixel, uint32_t sample_index, uint32_t dimension) const override;
+
+	std::unique_ptr<ISampler> clone() const override { return std::make_unique<IndependentSampler>(*this); }
+};
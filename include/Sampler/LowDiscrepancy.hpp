@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "Sampler/PCG32.hpp"
+
+/**
+ * @brief
+ * Building blocks of the samplers: hashing, random permutations and scrambled Sobol points.
+ * They are all stateless functions of their arguments.
+ */
+
+/** @brief Largest float below 1 */
+constexpr auto ONE_MINUS_EPSILON = 0x1.fffffep-1f;
+
+/** @brief Hash of the seed, the pixel, the sample index and the dimension of a sample */
+inline uint64_t hashSample(uint64_t seed, const glm::uvec2& pixel, uint32_t sample_index, uint32_t dimension)
+{
+	auto pixel_key = (static_cast<uint64_t>(pixel.y) << 32) | pixel.x;
+	return hashSeed(seed ^ hashSeed(pixel_key ^ hashSeed((static_cast<uint64_t>(sample_index) << 32) | dimension)));
+}
+
+/** @brief Float in [0, 1) from the upper 24 bits of a 32-bit value (a fixed-point fraction) */
+inline float toUnitFloat(uint32_t bits)
+{
+	return static_cast<float>(bits >> 8) * 0x1p-24f;
+}
+
+inline uint32_t reverseBits(uint32_t x)
+{
+	x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+	x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+	x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+	x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+/**
+ * @brief Element i of a random permutation of [0, count), selected by seed, without storing the permutation
+ * (Kensler, "Correlated Multi-Jittered Sampling", 2013). The hash is a bijection on the next power of two,
+ * iterated until the result falls in [0, count).
+ */
+inline uint32_t permuteIndex(uint32_t i, uint32_t count, uint32_t seed)
+{
+	auto mask = count - 1u;
+	mask |= mask >> 1;
+	mask |= mask >> 2;
+	mask |= mask >> 4;
+	mask |= mask >> 8;
+	mask |= mask >> 16;
+	do
+	{
+		i ^= seed;
+		i *= 0xe170893du;
+		i ^= seed >> 16;
+		i ^= (i & mask) >> 4;
+		i ^= seed >> 8;
+		i *= 0x0929eb3fu;
+		i ^= seed >> 23;
+		i ^= (i & mask) >> 1;
+		i *= 1u | seed >> 27;
+		i *= 0x6935fa69u;
+		i ^= (i & mask) >> 11;
+		i *= 0x74dcb303u;
+		i ^= (i & mask) >> 2;
+		i *= 0x9e501cc3u;
+		i ^= (i & mask) >> 2;
+		i *= 0xc860a3dfu;
+		i &= mask;
+		i ^= i >> 5;
+	} while (i >= count);
+	return (i + seed) % count;
+}
+
+/**
+ * @brief
+ * Owen scrambling of a 32-bit fixed-point fraction: every bit is flipped or not depending on a hash of the bits
+ * above it, which randomizes the points while keeping their stratification
+ * (Burley, "Practical Hash-based Owen Scrambling", 2020, with the hash of Laine and Karras).
+ * Applied to a sample index instead of a value, it shuffles the order of the points of the sequence.
+ */
+inline uint32_t owenScramble(uint32_t x, uint32_t seed)
+{
+	x = reverseBits(x);
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return reverseBits(x);
+}
+
+/**
+ * @brief
+ * First two dimensions of the Sobol sequence, as 32-bit fixed-point fractions.
+ * The first is the van der Corput sequence (the bits of the index mirrored around the binary point); the second
+ * uses the direction numbers v_1 = 1/2, v_(k+1) = v_k xor (v_k / 2). Every power of two prefix of these points is a
+ * (0, m, 2)-net: each of the 2^m elementary intervals of area 2^-m contains exactly one point.
+ */
+inline glm::uvec2 sobol2D(uint32_t index)
+{
+	auto x = reverseBits(index);
+	auto y = 0u;
+	for (auto v = 1u << 31; index != 0u; index >>= 1, v ^= v >> 1)
+		if (index & 1u)
+			y ^= v;
+	return glm::uvec2(x, y);
+}
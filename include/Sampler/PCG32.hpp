@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+/**
+ * @brief
+ * Monte Carlo rendering consumes a very large amount of random numbers, and every render thread needs its own stream.
+ * A shared generator (such as std::rand, used by glm::linearRand) serializes the threads on its global state,
+ * and makes the result depend on the order in which threads happen to draw numbers.
+ *
+ * PCG32 (M.E. O'Neill, "PCG: A Family of Simple Fast Space-Efficient Statistically Good Algorithms
+ * for Random Number Generation") is a 64-bit linear congruential generator whose output goes through
+ * a permutation: a xorshift followed by a random rotation. It needs 16 bytes of state, a multiplication
+ * and a few shifts per number, and it passes the standard statistical test suites.
+ * The increment selects one of 2^63 independent sequences, so a generator can be seeded per pixel:
+ * the image then only depends on the seed and not on how the work is split between threads.
+ */
+class PCG32
+{
+public:
+	PCG32(uint64_t init_state = 0x853c49e6748fea9bULL,
+				uint64_t init_sequence = 0xda3e39cb94b95bdbULL)
+	{
+		seed(init_state, init_sequence);
+	}
+	~PCG32() = default;
+
+	/** @brief Restart the generator on the given sequence */
+	void seed(uint64_t init_state, uint64_t init_sequence)
+	{
+		__state = 0u;
+		__increment = (init_sequence << 1u) | 1u;
+		nextUInt();
+		__state += init_state;
+		nextUInt();
+	}
+
+	/** @brief Uniformly distributed 32-bit integer */
+	uint32_t nextUInt()
+	{
+		auto old_state = __state;
+		__state = old_state * 0x5851f42d4c957f2dULL + __increment;
+		auto xorshifted = static_cast<uint32_t>(((old_state >> 18u) ^ old_state) >> 27u);
+		auto rotation = static_cast<uint32_t>(old_state >> 59u);
+		return (xorshifted >> rotation) | (xorshifted << ((~rotation + 1u) & 31u));
+	}
+
+	/** @brief Uniformly distributed float in [0, 1) */
+	float nextFloat()
+	{
+		// Use the upper 24 bits, which is the precision of the float mantissa
+		return static_cast<float>(nextUInt() >> 8) * 0x1p-24f;
+	}
+
+	glm::vec2 nextFloat2()
+	{
+		auto x = nextFloat();
+		return glm::vec2(x, nextFloat());
+	}
+
+private:
+	uint64_t __state;
+	uint64_t __increment;
+};
+
+/** @brief Mix the bits of a 64-bit value (SplitMix64 finalizer), used to derive seeds from pixel coordinates */
+inline uint64_t hashSeed(uint64_t value)
+{
+	value += 0x9e3779b97f4a7c15ULL;
+	value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+	return value ^ (value >> 31);
+}
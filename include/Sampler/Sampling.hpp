@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cmath>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+/**
+ * @brief
+ * Warps from uniform numbers to the distributions the renderer draws from.
+ * Each routine inverts the cumulative distribution of its target in closed form: one point of [0, 1)^2 gives
+ * one sample, with no rejection loop and no renormalization, and points that are well spread in the square
+ * (see ISampler) stay well spread on the disk or the hemisphere.
+ * Directions are generated in a local frame whose z axis is the normal, then taken to world space by an OrthonormalBasis.
+ * Densities are per unit solid angle.
+ */
+
+/**
+ * @brief
+ * Frame around a unit vector, without branches or normalizations
+ * (Duff et al., "Building an Orthonormal Basis, Revisited", 2017).
+ */
+struct OrthonormalBasis
+{
+	explicit OrthonormalBasis(const glm::vec3& n) : normal{ n }
+	{
+		auto sign = std::copysign(1.f, n.z);
+		auto a = -1.f / (sign + n.z);
+		auto b = n.x * n.y * a;
+		tangent = glm::vec3(1.f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+		bitangent = glm::vec3(b, sign + n.y * n.y * a, -n.y);
+	}
+
+	/** @brief Vector of the local frame (z along the normal) in world space */
+	glm::vec3 toWorld(const glm::vec3& v) const { return v.x * tangent + v.y * bitangent + v.z * normal; }
+
+	glm::vec3 tangent;
+	glm::vec3 bitangent;
+	glm::vec3 normal;
+};
+
+/** @brief Point of the unit disk, uniformly distributed if u is */
+inline glm::vec2 sampleUniformDisk(const glm::vec2& u)
+{
+	// Concentric mapping (Shirley and Chiu, "A Low Distortion Map Between Disk and Square", 1997): the square [-1, 1]^2
+	// is mapped ring by ring, so neighbouring points stay neighbours, unlike r = sqrt(u.x), phi = 2pi * u.y
+	auto offset = 2.f * u - 1.f;
+	if (offset.x == 0.f && offset.y == 0.f)
+		return glm::vec2(0.f);
+
+	auto r = offset.y;
+	auto theta = glm::half_pi<float>() - glm::quarter_pi<float>() * (offset.x / offset.y);
+	if (glm::abs(offset.x) > glm::abs(offset.y))
+	{
+		r = offset.x;
+		theta = glm::quarter_pi<float>() * (offset.y / offset.x);
+	}
+	return r * glm::vec2(glm::cos(theta), glm::sin(theta));
+}
+
+/** @brief Direction of the hemisphere z > 0 with density cos(theta) / pi */
+inline glm::vec3 sampleCosineHemisphere(const glm::vec2& u)
+{
+	// Malley's method: points uniformly distributed on the disk, projected up to the hemisphere
+	auto d = sampleUniformDisk(u);
+	auto z = glm::sqrt(glm::max(0.f, 1.f - d.x * d.x - d.y * d.y));
+	return glm::vec3(d.x, d.y, z);
+}
+
+inline float cosineHemispherePdf(float cos_theta) { return glm::max(cos_theta, 0.f) * glm::one_over_pi<float>(); }
+
+/**
+ * @brief
+ * GGX (Trowbridge-Reitz) distribution of microfacet normals, with roughness alpha
+ * (Walter et al., "Microfacet Models for Refraction through Rough Surfaces", 2007).
+ */
+inline float ggxDistribution(float cos_theta, float alpha)
+{
+	if (cos_theta <= 0.f)
+		return 0.f;
+	auto alpha2 = alpha * alpha;
+	auto denominator = cos_theta * cos_theta * (alpha2 - 1.f) + 1.f;
+	return alpha2 / (glm::pi<float>() * denominator * denominator);
+}
+
+/** @brief Microfacet normal of the hemisphere z > 0 with density ggxPdf(cos(theta), alpha) = D(m) * cos(theta) */
+inline glm::vec3 sampleGGX(const glm::vec2& u, float alpha)
+{
+	// The cumulative distribution of theta inverts to tan^2(theta) = alpha^2 * u / (1 - u)
+	auto tan2_theta = alpha * alpha * u.x / (1.f - u.x);
+	auto cos_theta = 1.f / glm::sqrt(1.f + tan2_theta);
+	auto sin_theta = glm::sqrt(glm::max(0.f, 1.f - cos_theta * cos_theta));
+	auto phi = 2.f * glm::pi<float>() * u.y;
+	return glm::vec3(sin_theta * glm::cos(phi), sin_theta * glm::sin(phi), cos_theta);
+}
+
+inline float ggxPdf(float cos_theta, float alpha) { return ggxDistribution(cos_theta, alpha) * cos_theta; }
+
+/**
+ * @brief
+ * Smith masking of the GGX distribution: the fraction of the microfacets facing a direction that are not hidden from it
+ * by other facets, for a direction at cos_theta from the normal. The masking-shadowing term of a pair of directions
+ * is the product of their two maskings.
+ */
+inline float ggxMasking(float cos_theta, float alpha)
+{
+	if (cos_theta <= 0.f)
+		return 0.f;
+	auto cos2_theta = cos_theta * cos_theta;
+	auto tan2_theta = (1.f - cos2_theta) / cos2_theta;
+	return 2.f / (1.f + glm::sqrt(1.f + alpha * alpha * tan2_theta));
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "ISampler.hpp"
+
+/**
+ * @brief
+ * Owen-scrambled Sobol points (Burley, "Practical Hash-based Owen Scrambling", 2020).
+ * Each pair of dimensions takes the first two dimensions of the Sobol sequence, whose power of two prefixes are
+ * stratified in every elementary interval, not only on a grid. Sobol points of higher dimensions are poorly
+ * distributed in their projections, so instead the pairs are "padded": each one shuffles the order of the points
+ * and scrambles their values with its own seed (hash of the pixel, the dimension and the seed), which decorrelates
+ * the pairs from each other and the pixels from each other, while each pair stays a scrambled (0, 2)-sequence.
+ * The sequence is progressive: any number of samples is well distributed, best at powers of two.
+ */
+class SobolSampler : public ISampler
+{
+public:
+	SobolSampler(uint64_t seed = 0u) : ISampler(seed) {}
+	~SobolSampler() = default;
+
+	float compute1D(const glm::uvec2& pixel, uint32_t sample_index, uint32_t dimension) const override;
+	glm::vec2 compute2D(const glm::uvec2& pixel, uint32_t sample_index, uint32_t dimension) const override;
+
+	std::unique_ptr<ISampler> clone() const override { return std::make_unique<SobolSampler>(*this); }
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "ISampler.hpp"
+
+/**
+ * @brief
+ * Jittered stratification: the samples of a pixel are spread over as many strata of each dimension
+ * (a grid of cells for pairs of dimensions), one random point per stratum. The strata are visited in a random order,
+ * different for each pixel and dimension, so that the dimensions are not correlated with each other.
+ * When the sample count is not a square, the grid has a few more cells than samples, and some stay empty.
+ * Samples beyond samples_per_pixel start a new round of strata.
+ */
+class StratifiedSampler : public ISampler
+{
+public:
+	StratifiedSampler(uint32_t samples_per_pixel, uint64_t seed = 0u);
+	~StratifiedSampler() = default;
+
+	float compute1D(const glm::uvec2& pixel, uint32_t sample_index, uint32_t dimension) const override;
+	glm::vec2 compute2D(const glm::uvec2& pixel, uint32_t sample_index, uint32_t dimension) const override;
+
+	std::unique_ptr<ISampler> clone() const override { return std::make_unique<StratifiedSampler>(*this); }
+
+private:
+	uint32_t __samples_per_pixel;
+	glm::uvec2 __grid;		// strata of the pairs of dimensions
+};
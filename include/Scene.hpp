@@ -3,9 +3,33 @@
 #include <vector>
 #include <memory>
 #include "Geometry/IHittableObject.hpp"
+#include "Accelerator/BVH.hpp"
+#include "Accelerator/BVH4.hpp"
+#include "CompiledScene.hpp"
+#include "Material/MaterialTable.hpp"
+#include "Sampler/AliasTable.hpp"
 
 class Ray;
 
+/** 
+ * @brief Flattened description of an emissive object, used for direct lighting. 
+ * The light table is rebuilt by Scene::add/clear, so the renderer never has to inspect materials at shading time.
+ */
+struct LightSource
+{
+	glm::vec3 position;							// world position of the emitter
+	glm::vec3 emission;							// emission scale of its Emissive material
+	const IHittableObject* object;	// the emitting object, owned by the scene
+	uint32_t material_id;						// its material in the material table, updated by Scene::build
+};
+
+/** @brief Traversal kernel used for the scene hierarchy */
+enum class TraversalKernel
+{
+	BINARY,		// binary BVH, one box at a time
+	WIDE_4,		// 4-wide BVH, four boxes at a time with SIMD instructions
+};
+
 class Scene
 {
 public:
@@ -14,11 +38,29 @@ public:
 
 	void add(std::shared_ptr<IHittableObject> object);
 	void clear();
+
+	/** 
+	 * @brief Build the acceleration structure over the current objects. 
+	 * Must be called once the scene is complete; adding or removing objects invalidates it.
+	 */
+	void build();
+	bool isBuilt() const { return __bvh.isBuilt(); }
+	const auto& getBuildStats() const { return __bvh.getBuildStats(); }
+
+	/** @brief Both hierarchies are always built, so the kernel can be switched at any time (e.g. to compare them) */
+	void setTraversalKernel(TraversalKernel kernel) { __traversal_kernel = kernel; }
+	auto getTraversalKernel() const { return __traversal_kernel; }
+
 	bool rayCasting(const Ray& ray,
 									float t_min,
 									float t_max,
 									HitRecord& record) const;
 
+	/** @brief Return true if any object blocks the ray between t_min and t_max (shadow rays) */
+	bool occluded(const Ray& ray,
+								float t_min,
+								float t_max) const;
+
 	const auto& getObjects() const { return __objects; }
 	
 	/** @brief Retrieve specific types of objects */
@@ -38,6 +80,35 @@ public:
 	/** @brief Get all objects that have an Emissive material */
 	std::vector<std::shared_ptr<IHittableObject>> getEmissiveObjects() const;
 
+	/** @brief Precomputed table of the emissive objects, in insertion order */
+	const auto& getLights() const { return __lights; }
+
+	/**
+	 * @brief Id of the objects that are not in the light table. A hit reports the index of its object in the table
+	 * in HitRecord::light_id; emissive objects nested in groups or instances are not in the table.
+	 */
+	static constexpr auto NO_LIGHT = IHittableObject::NO_LIGHT;
+
+	/**
+	 * @brief Distribution of the lights in proportion to their power, estimated as the luminance of their
+	 * emission scale times their area (textures are not taken into account). Lights that cannot be sampled have no power.
+	 * Built by build(), once all the lights are known; empty until then.
+	 */
+	const auto& getLightDistribution() const { return __light_distribution; }
+
+	/** @brief Materials of the objects; HitRecord::material_id indexes this table */
+	const auto& getMaterialTable() const { return __materials; }
+
 private:
+	void __buildLightDistribution();
+
 	std::vector<std::shared_ptr<IHittableObject>> __objects;
+	std::vector<LightSource> __lights;
+	AliasTable __light_distribution;
+	MaterialTable __materials;
+
+	BVH __bvh;
+	BVH4 __bvh4;	// collapsed from __bvh, shares its leaf order
+	CompiledScene __compiled;	// objects in BVH leaf order, grouped by type
+	TraversalKernel __traversal_kernel = TraversalKernel::WIDE_4;
 };
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cmath>
+
+#if defined(__AVX__)
+	#include <immintrin.h>
+	#define RAYTRACING_SIMD_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <xmmintrin.h>
+	#define RAYTRACING_SIMD_SSE
+#endif
+
+/**
+ * @brief
+ * Thin wrappers over the SIMD instructions, so that the kernels (SphereSet, Denoiser) are written once for every width:
+ * 8 lanes with AVX, 4 with SSE, and a scalar fallback elsewhere.
+ * A mask has all bits set in the lanes where a comparison holds.
+ */
+namespace simd
+{
+#if defined(RAYTRACING_SIMD_AVX)
+	constexpr auto simd_width = 8u;
+	using FloatN = __m256;
+	using MaskN = __m256;
+
+	inline FloatN load(const float* p) { return _mm256_loadu_ps(p); }
+	inline void store(float* p, FloatN v) { _mm256_storeu_ps(p, v); }
+	inline FloatN broadcast(float v) { return _mm256_set1_ps(v); }
+	inline FloatN laneOffsets() { return _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f); }
+	inline FloatN add(FloatN a, FloatN b) { return _mm256_add_ps(a, b); }
+	inline FloatN sub(FloatN a, FloatN b) { return _mm256_sub_ps(a, b); }
+	inline FloatN mul(FloatN a, FloatN b) { return _mm256_mul_ps(a, b); }
+	inline FloatN div(FloatN a, FloatN b) { return _mm256_div_ps(a, b); }
+	inline FloatN min(FloatN a, FloatN b) { return _mm256_min_ps(a, b); }
+	inline FloatN max(FloatN a, FloatN b) { return _mm256_max_ps(a, b); }
+	inline FloatN sqrt(FloatN a) { return _mm256_sqrt_ps(a); }
+	inline MaskN greaterEqual(FloatN a, FloatN b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+	inline MaskN lessEqual(FloatN a, FloatN b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+	inline MaskN lessThan(FloatN a, FloatN b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	inline MaskN logicalAnd(MaskN a, MaskN b) { return _mm256_and_ps(a, b); }
+	inline FloatN select(MaskN mask, FloatN a, FloatN b) { return _mm256_blendv_ps(b, a, mask); }
+	inline bool any(MaskN mask) { return _mm256_movemask_ps(mask) != 0; }
+#elif defined(RAYTRACING_SIMD_SSE)
+	constexpr auto simd_width = 4u;
+	using FloatN = __m128;
+	using MaskN = __m128;
+
+	inline FloatN load(const float* p) { return _mm_loadu_ps(p); }
+	inline void store(float* p, FloatN v) { _mm_storeu_ps(p, v); }
+	inline FloatN broadcast(float v) { return _mm_set1_ps(v); }
+	inline FloatN laneOffsets() { return _mm_setr_ps(0.f, 1.f, 2.f, 3.f); }
+	inline FloatN add(FloatN a, FloatN b) { return _mm_add_ps(a, b); }
+	inline FloatN sub(FloatN a, FloatN b) { return _mm_sub_ps(a, b); }
+	inline FloatN mul(FloatN a, FloatN b) { return _mm_mul_ps(a, b); }
+	inline FloatN div(FloatN a, FloatN b) { return _mm_div_ps(a, b); }
+	inline FloatN min(FloatN a, FloatN b) { return _mm_min_ps(a, b); }
+	inline FloatN max(FloatN a, FloatN b) { return _mm_max_ps(a, b); }
+	inline FloatN sqrt(FloatN a) { return _mm_sqrt_ps(a); }
+	inline MaskN greaterEqual(FloatN a, FloatN b) { return _mm_cmpge_ps(a, b); }
+	inline MaskN lessEqual(FloatN a, FloatN b) { return _mm_cmple_ps(a, b); }
+	inline MaskN lessThan(FloatN a, FloatN b) { return _mm_cmplt_ps(a, b); }
+	inline MaskN logicalAnd(MaskN a, MaskN b) { return _mm_and_ps(a, b); }
+	inline FloatN select(MaskN mask, FloatN a, FloatN b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+	inline bool any(MaskN mask) { return _mm_movemask_ps(mask) != 0; }
+#else
+	constexpr auto simd_width = 1u;
+	using FloatN = float;
+	using MaskN = bool;
+
+	inline FloatN load(const float* p) { return *p; }
+	inline void store(float* p, FloatN v) { *p = v; }
+	inline FloatN broadcast(float v) { return v; }
+	inline FloatN laneOffsets() { return 0.f; }
+	inline FloatN add(FloatN a, FloatN b) { return a + b; }
+	inline FloatN sub(FloatN a, FloatN b) { return a - b; }
+	inline FloatN mul(FloatN a, FloatN b) { return a * b; }
+	inline FloatN div(FloatN a, FloatN b) { return a / b; }
+	inline FloatN min(FloatN a, FloatN b) { return a < b ? a : b; }
+	inline FloatN max(FloatN a, FloatN b) { return a > b ? a : b; }
+	inline FloatN sqrt(FloatN a) { return std::sqrt(a); }
+	inline MaskN greaterEqual(FloatN a, FloatN b) { return a >= b; }
+	inline MaskN lessEqual(FloatN a, FloatN b) { return a <= b; }
+	inline MaskN lessThan(FloatN a, FloatN b) { return a < b; }
+	inline MaskN logicalAnd(MaskN a, MaskN b) { return a && b; }
+	inline FloatN select(MaskN mask, FloatN a, FloatN b) { return mask ? a : b; }
+	inline bool any(MaskN mask) { return mask; }
+#endif
+
+	inline FloatN abs(FloatN a) { return max(a, sub(broadcast(0.f), a)); }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <type_traits>
+#include <cstdint>
+
+/**
+ * @brief
+ * Fixed set of threads for the parallel loops of a render (the stages of WavefrontRenderer, the passes of Denoiser).
+ * The threads are started once, by the constructor, and sleep between loops: a loop costs a wake-up instead of
+ * creating and joining a thread per worker, which matters when loops are short and many (one per stage and bounce).
+ * The thread that calls parallelFor takes part in the loop, so a pool of thread_count threads starts thread_count - 1.
+ */
+class ThreadPool
+{
+public:
+	explicit ThreadPool(uint32_t thread_count = 1u);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/** @brief Number of threads that run a loop, the calling one included */
+	uint32_t getThreadCount() const { return static_cast<uint32_t>(__workers.size()) + 1u; }
+
+	/**
+	 * @brief Call function(i) for every i in [0, count), on all threads, and return when all calls are done.
+	 * Indices are handed out chunk_size at a time through an atomic counter, so threads that get cheap items take more.
+	 * The function can also take the index of the thread that calls it, function(i, thread), with thread in [0, getThreadCount()).
+	 */
+	template<typename Function>
+	void parallelFor(uint32_t count, uint32_t chunk_size, Function&& function);
+
+private:
+	/** @brief Run job(context, thread) once on every thread, the calling one as thread 0 */
+	void __run(void (*job)(void*, uint32_t), void* context);
+	void __workerLoop(uint32_t thread);
+
+	std::vector<std::jthread> __workers;
+	std::mutex __mutex;
+	std::condition_variable __job_ready;
+	std::condition_variable __job_done;
+	void (*__job)(void*, uint32_t) = nullptr;
+	void* __job_context = nullptr;
+	uint64_t __job_generation = 0;		// incremented by each job, so that a worker runs it exactly once
+	uint32_t __busy_workers = 0;
+	bool __stopping = false;
+};
+
+template<typename Function>
+void ThreadPool::parallelFor(uint32_t count, uint32_t chunk_size, Function&& function)
+{
+	chunk_size = std::max(chunk_size, 1u);
+	std::atomic<uint32_t> next_chunk = 0;
+	auto job = [&](uint32_t thread) -> void {
+		for (auto first = next_chunk.fetch_add(chunk_size); first < count; first = next_chunk.fetch_add(chunk_size))
+		{
+			auto last = std::min(first + chunk_size, count);
+			for (auto i = first; i < last; ++i)
+			{
+				if constexpr (std::is_invocable_v<Function, uint32_t, uint32_t>)
+					function(i, thread);
+				else
+					function(i);
+			}
+		}
+	};
+
+	// A single chunk is not worth waking the workers
+	if (__workers.empty() || count <= chunk_size)
+	{
+		job(0u);
+		return;
+	}
+	__run([](void* context, uint32_t thread) { (*static_cast<decltype(job)*>(context))(thread); }, &job);
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <span>
+#include <memory>
+#include <cstdint>
+
+#include "Ray.hpp"
+#include "Renderer.hpp"
+#include "ThreadPool.hpp"
+
+class Scene;
+class ISampler;
+
+/**
+ * @brief
+ * Path tracer that advances a whole batch of paths one bounce at a time (wavefront path tracing,
+ * Laine, Karras and Aila, "Megakernels Considered Harmful: Wavefront Path Tracing on GPUs", 2013).
+ * Renderer::computeRayColor follows one path from the camera to its end, alternating between traversal,
+ * shading and shadow rays, so consecutive instructions and memory accesses have little in common.
+ * Here each step runs over all the paths of the batch before the next one starts:
+ *	- extend: find the closest hit of every ray in the queue;
+ *	- shade: evaluate the materials, sorted by material id (so also by type, see MaterialTable), add the emitted light,
+ *		sample the lights and produce the shadow rays and the queue of continuing rays;
+ *	- shadow: trace all the shadow rays;
+ *	- accumulate: add the direct light of the unoccluded shadow rays to the radiance of each path.
+ * The path state and the queues are structures of arrays, and each stage is a parallel loop over its queue, run by
+ * threads that are started once with the renderer (see ThreadPool). Queues are sorted and compacted in parallel,
+ * block by block, and keep the path order, so the result does not depend on the number of threads.
+ *
+ * The estimator is the one of Renderer::computeRayColor, with the same operations in the same order:
+ * given the same sample, a path gets exactly the same radiance. Each path keeps the dimension of its sample
+ * it has reached, and resumes from it at the next bounce (see ISampler).
+ */
+class WavefrontRenderer
+{
+public:
+	WavefrontRenderer(uint32_t thread_count = 1u) : __thread_pool{ thread_count } {}
+	~WavefrontRenderer() = default;
+
+	uint32_t getThreadCount() const { return __thread_pool.getThreadCount(); }
+
+	/**
+	 * @brief Trace one path per camera ray: path i starts from camera_rays[i], made from the first
+	 * ISampler::CAMERA_DIMENSIONS dimensions of sample sample_indices[i] of pixels[i], takes the next dimensions
+	 * of that sample from sampler and writes its radiance to radiance[i].
+	 * If auxiliary is not empty, it receives the AOVs of the first hit of each path.
+	 */
+	void computeRayColors(std::span<const Ray> camera_rays,
+												std::span<const glm::uvec2> pixels,
+												std::span<const uint32_t> sample_indices,
+												const Scene& scene,
+												const ISampler& sampler,
+												std::span<glm::vec3> radiance,
+												uint32_t max_depth,
+												uint32_t russian_roulette_depth,
+												LightSelection light_selection = LightSelection::ALL,
+												std::span<AuxiliarySample> auxiliary = {});
+
+private:
+	enum PathFlags : uint8_t
+	{
+		PATH_HIT = 1,					// the ray found a surface
+		PATH_SAMPLES_LIGHTS = 2,		// the material is not specular: shadow rays and direct light
+		PATH_CONTINUES = 4,		// the path survived Russian roulette and has a next ray
+	};
+
+	void __resize(uint32_t path_count, uint32_t light_sample_count);
+
+	void __extend(const Scene& scene);
+	void __shade(const Scene& scene, uint32_t depth, uint32_t russian_roulette_depth);
+	void __traceShadowRays(const Scene& scene);
+	void __accumulate();
+
+	/** @brief Sort the hit queue by material id (counting sort, stable so that paths stay in order within a material) */
+	void __sortHitsByMaterial(uint32_t material_count);
+
+	/** @brief Write to queue the paths of source whose flags contain flag, keeping their order */
+	uint32_t __compact(std::span<const uint32_t> source, uint8_t flag, std::vector<uint32_t>& queue);
+
+	/** @brief Call function(i), or function(i, thread), for every i in [0, count) on the threads of the pool */
+	template<typename Function>
+	void __parallelFor(uint32_t count, Function&& function);
+
+	/** @brief The ray of a path, copied as is (the constructor of Ray would normalize the direction again) */
+	Ray __loadRay(uint32_t path) const;
+
+	ThreadPool __thread_pool;
+	LightSelection __light_selection = LightSelection::ALL;
+	std::span<AuxiliarySample> __auxiliary;		// output of computeRayColors, empty if not requested
+	uint32_t __light_sample_count = 0;	// shadow rays per path
+	std::vector<std::unique_ptr<ISampler>> __samplers;		// one per thread
+
+	// Path state, indexed by path
+	std::vector<glm::vec3> __ray_origin;
+	std::vector<glm::vec3> __ray_direction;
+	std::vector<glm::vec3> __throughput;
+	std::vector<float> __bsdf_pdf;		// density of the ray direction, 0 for camera rays and after specular bounces
+	std::vector<glm::vec3> __radiance;
+	std::vector<uint8_t> __flags;
+	std::vector<glm::uvec2> __pixel;
+	std::vector<uint32_t> __sample_index;
+	std::vector<uint32_t> __dimension;		// next dimension of the sample
+	std::vector<uint8_t> __auxiliary_pending;		// AOVs requested and no non-specular hit yet (see Renderer::computeRayColor)
+	std::vector<glm::vec3> __auxiliary_albedo;
+	std::vector<float> __auxiliary_distance;
+
+	// Closest hit, indexed by path
+	std::vector<glm::vec3> __hit_point;
+	std::vector<glm::vec3> __hit_normal;
+	std::vector<glm::vec2> __hit_texture_coordinates;
+	std::vector<uint32_t> __hit_material;
+	std::vector<uint8_t> __hit_outside;
+	std::vector<uint32_t> __hit_light;
+
+	// Shading results, indexed by path
+	std::vector<glm::vec3> __shading_throughput;	// throughput at the hit, before the bounce
+
+	// Shadow rays, one per path and light sample: entry path * light_sample_count + light_sample
+	std::vector<glm::vec3> __shadow_direction;
+	std::vector<float> __shadow_distance;		// 0 if the light sample brings no light: no shadow ray
+	std::vector<glm::vec3> __shadow_contribution;
+	std::vector<uint8_t> __shadow_visible;
+
+	// Queues of path indices
+	std::vector<uint32_t> __ray_queue;
+	std::vector<uint32_t> __hit_queue;
+	std::vector<uint32_t> __sorted_hit_queue;
+	std::vector<uint32_t> __light_sampling_queue;
+	std::vector<uint32_t> __material_offsets;		// per material and block of the hit queue (see __sortHitsByMaterial)
+	std::vector<uint32_t> __block_offsets;			// per block of the source queue (see __compact)
+	uint32_t __ray_count = 0;
+	uint32_t __hit_count = 0;
+	uint32_t __light_sampling_count = 0;
+};
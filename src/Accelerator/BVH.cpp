@@ -0,0 +1,356 @@
+#include "Accelerator/BVH.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cassert>
+
+namespace
+{
+	constexpr auto bin_count = 12u;
+	constexpr auto traversal_cost = 0.5f;								// relative to the cost of one primitive intersection
+	constexpr auto max_sah_depth = BVH::TRAVERSAL_STACK_SIZE - 33u;	// past this depth, fall back to median splits to bound the traversal stack
+	// Median splits halve a 32-bit primitive count, so they reach single primitives within 32 more levels
+	static_assert(max_sah_depth + 32u < BVH::TRAVERSAL_STACK_SIZE);
+	constexpr auto min_task_size = 4096u;								// smallest subtree handed to another thread
+	constexpr auto min_parallel_binning_size = 65536u;	// smallest node whose primitives are binned by several threads
+
+	/** @brief Bounds of the primitives of a node and of their centroids */
+	struct NodeBounds
+	{
+		AABB bounds;
+		AABB centroid_bounds;
+
+		void merge(const NodeBounds& other)
+		{
+			bounds.expand(other.bounds);
+			centroid_bounds.expand(other.centroid_bounds);
+		}
+	};
+
+	/** @brief Primitive counts and bounds of each bin, along the three axes */
+	struct Bins
+	{
+		AABB bounds[3][bin_count];
+		uint32_t counts[3][bin_count] = {};
+
+		void merge(const Bins& other)
+		{
+			for (auto axis = 0; axis < 3; ++axis)
+			{
+				for (auto b = 0u; b < bin_count; ++b)
+				{
+					bounds[axis][b].expand(other.bounds[axis][b]);
+					counts[axis][b] += other.counts[axis][b];
+				}
+			}
+		}
+	};
+
+	/**
+	 * @brief Split [0, count) in one chunk per thread, run the chunks concurrently and merge the partial results.
+	 * Small ranges are processed on the calling thread.
+	 */
+	template<typename Result, typename ChunkFn>
+	Result parallelReduce(uint32_t count, uint32_t thread_count, ChunkFn&& chunk_fn)
+	{
+		if (count < min_parallel_binning_size || thread_count < 2)
+		{
+			auto result = Result{};
+			chunk_fn(0u, count, result);
+			return result;
+		}
+
+		auto partial_results = std::vector<Result>(thread_count);
+		auto chunk_size = (count + thread_count - 1) / thread_count;
+		{
+			std::vector<std::jthread> threads;
+			threads.reserve(thread_count);
+			for (auto i = 0u; i < thread_count; ++i)
+			{
+				auto begin = std::min(i * chunk_size, count);
+				auto end = std::min(begin + chunk_size, count);
+				threads.emplace_back(chunk_fn, begin, end, std::ref(partial_results[i]));
+			}
+		}
+
+		auto result = partial_results[0];
+		for (auto i = 1u; i < thread_count; ++i)
+			result.merge(partial_results[i]);
+		return result;
+	}
+}
+
+struct BVH::BuildContext
+{
+	std::vector<Node>& nodes;
+	std::span<const AABB> primitive_bounds;
+	std::span<const glm::vec3> centroids;
+	uint32_t max_leaf_size;
+	uint32_t thread_count;
+
+	std::atomic<uint32_t> node_count;
+	std::atomic<uint32_t> leaf_count;
+	std::atomic<uint32_t> max_depth;
+	std::atomic<uint32_t> active_tasks;
+};
+
+/**
+ * ============================================
+ *		PUBLIC
+ * ============================================
+ */
+
+void BVH::build(std::span<const AABB> primitive_bounds, uint32_t max_leaf_size)
+{
+	clear();
+	if (primitive_bounds.empty())
+		return;
+
+	assert(max_leaf_size > 0 && max_leaf_size <= UINT16_MAX);
+
+	auto start_time = std::chrono::steady_clock::now();
+	auto primitive_count = static_cast<uint32_t>(primitive_bounds.size());
+	auto thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+	// The arrays are owned by a shared block, which the spans of this BVH (and of its copies) point to
+	struct Storage
+	{
+		std::vector<Node> nodes;
+		std::vector<uint32_t> primitive_indices;
+	};
+	auto storage = std::make_shared<Storage>();
+
+	auto centroids = std::vector<glm::vec3>(primitive_count);
+	parallelReduce<NodeBounds>(primitive_count, thread_count, [&](uint32_t begin, uint32_t end, NodeBounds&) {
+		for (auto i = begin; i < end; ++i)
+			centroids[i] = primitive_bounds[i].getCentroid();
+	});
+
+	auto& primitive_indices = storage->primitive_indices;
+	primitive_indices.resize(primitive_count);
+	std::iota(primitive_indices.begin(), primitive_indices.end(), 0u);
+
+	// A binary tree with N leaves has 2N - 1 nodes, so this is an upper bound for any split.
+	auto& nodes = storage->nodes;
+	nodes.resize(2 * primitive_count - 1);
+
+	auto context = BuildContext{
+		nodes,
+		primitive_bounds,
+		centroids,
+		max_leaf_size,
+		thread_count,
+		1u,	// node_count: the root
+		0u,	// leaf_count
+		0u,	// max_depth
+		0u,	// active_tasks
+	};
+	__buildRecursive(context, 0, primitive_indices, 0, 0);
+
+	nodes.resize(context.node_count);
+	nodes.shrink_to_fit();
+	__nodes = nodes;
+	__primitive_indices = primitive_indices;
+	__storage = std::move(storage);
+
+	const auto end_time = std::chrono::steady_clock::now();
+	__build_stats.build_time_ms = std::chrono::duration<float, std::milli>(end_time - start_time).count();
+	__build_stats.node_count = context.node_count;
+	__build_stats.leaf_count = context.leaf_count;
+	__build_stats.max_depth = context.max_depth;
+	__build_stats.thread_count = thread_count;
+}
+
+void BVH::assign(std::span<const Node> nodes,
+								 std::span<const uint32_t> primitive_indices,
+								 std::shared_ptr<const void> storage)
+{
+	clear();
+	__nodes = nodes;
+	__primitive_indices = primitive_indices;
+	__storage = std::move(storage);
+	__build_stats.node_count = static_cast<uint32_t>(nodes.size());
+}
+
+void BVH::clear()
+{
+	__nodes = {};
+	__primitive_indices = {};
+	__storage.reset();
+	__build_stats = BuildStats{};
+}
+
+/**
+ * ============================================
+ *		PRIVATE
+ * ============================================
+ */
+
+void BVH::__buildRecursive(BuildContext& context,
+													 uint32_t node_index,
+													 std::span<uint32_t> indices,
+													 uint32_t first,
+													 uint32_t depth)
+{
+	const auto& primitive_bounds = context.primitive_bounds;
+	const auto& centroids = context.centroids;
+	auto count = static_cast<uint32_t>(indices.size());
+	// Split the cores between the subtrees that are already being built
+	auto parallel_threads = std::max(1u, context.thread_count / (context.active_tasks.load(std::memory_order_relaxed) + 1));
+
+	auto node_bounds = parallelReduce<NodeBounds>(count, parallel_threads, [&](uint32_t begin, uint32_t end, NodeBounds& result) {
+		for (auto i = begin; i < end; ++i)
+		{
+			result.bounds.expand(primitive_bounds[indices[i]]);
+			result.centroid_bounds.expand(centroids[indices[i]]);
+		}
+	});
+	const auto& bounds = node_bounds.bounds;
+	const auto& centroid_bounds = node_bounds.centroid_bounds;
+	auto& node = context.nodes[node_index];
+	node.bounds = bounds;
+
+	auto current_max_depth = context.max_depth.load(std::memory_order_relaxed);
+	while (depth > current_max_depth && !context.max_depth.compare_exchange_weak(current_max_depth, depth));
+
+	auto make_leaf = [&]() -> void {
+		node.offset = first;
+		node.primitive_count = static_cast<uint16_t>(count);
+		context.leaf_count.fetch_add(1, std::memory_order_relaxed);
+	};
+
+	if (count == 1)
+		return make_leaf();
+
+	// Look for the cheapest binned SAH split over the three axes
+	auto best_axis = -1;
+	auto best_bin = 0u;
+	auto best_cost = std::numeric_limits<float>::infinity();
+	auto centroid_extent = centroid_bounds.getExtent();
+	auto bin_scale = glm::vec3(0.f);
+	for (auto axis = 0; axis < 3; ++axis)
+		bin_scale[axis] = centroid_extent[axis] > 0.f ? bin_count / centroid_extent[axis] : 0.f;
+
+	if (depth < max_sah_depth)
+	{
+		auto bins = parallelReduce<Bins>(count, parallel_threads, [&](uint32_t begin, uint32_t end, Bins& result) {
+			for (auto i = begin; i < end; ++i)
+			{
+				auto index = indices[i];
+				for (auto axis = 0; axis < 3; ++axis)
+				{
+					auto b = static_cast<uint32_t>((centroids[index][axis] - centroid_bounds.min[axis]) * bin_scale[axis]);
+					b = std::min(b, bin_count - 1);
+					result.counts[axis][b]++;
+					result.bounds[axis][b].expand(primitive_bounds[index]);
+				}
+			}
+		});
+
+		for (auto axis = 0; axis < 3; ++axis)
+		{
+			if (centroid_extent[axis] <= 0.f)
+				continue;
+
+			// Sweep from the right to get the area and count of every right partition,
+			// then from the left to evaluate the cost of the split after each bin.
+			float right_areas[bin_count - 1];
+			uint32_t right_counts[bin_count - 1];
+			auto right_bounds = AABB();
+			auto right_count = 0u;
+			for (auto b = bin_count - 1; b > 0; --b)
+			{
+				right_bounds.expand(bins.bounds[axis][b]);
+				right_count += bins.counts[axis][b];
+				right_areas[b - 1] = right_bounds.getSurfaceArea();
+				right_counts[b - 1] = right_count;
+			}
+
+			auto left_bounds = AABB();
+			auto left_count = 0u;
+			for (auto b = 0u; b < bin_count - 1; ++b)
+			{
+				left_bounds.expand(bins.bounds[axis][b]);
+				left_count += bins.counts[axis][b];
+				if (left_count == 0 || right_counts[b] == 0)
+					continue;
+
+				auto cost = left_bounds.getSurfaceArea() * left_count + right_areas[b] * right_counts[b];
+				if (cost < best_cost)
+				{
+					best_cost = cost;
+					best_axis = axis;
+					best_bin = b;
+				}
+			}
+		}
+	}
+
+	auto mid = 0u;
+	if (best_axis >= 0)
+	{
+		auto parent_area = bounds.getSurfaceArea();
+		auto split_cost = traversal_cost + (parent_area > 0.f ? best_cost / parent_area : static_cast<float>(count));
+		auto leaf_cost = static_cast<float>(count);
+		if (count <= context.max_leaf_size && leaf_cost <= split_cost)
+			return make_leaf();
+
+		auto scale = bin_scale[best_axis];
+		auto min_value = centroid_bounds.min[best_axis];
+		auto middle = std::partition(indices.begin(), indices.end(), [&](uint32_t index) {
+			auto b = static_cast<uint32_t>((centroids[index][best_axis] - min_value) * scale);
+			return std::min(b, bin_count - 1) <= best_bin;
+		});
+		mid = static_cast<uint32_t>(middle - indices.begin());
+		node.axis = static_cast<uint8_t>(best_axis);
+	}
+	else
+	{
+		// All centroids coincide, or the tree is too deep: split by primitive count along the longest axis
+		if (count <= context.max_leaf_size)
+			return make_leaf();
+
+		auto axis = centroid_bounds.getLongestAxis();
+		mid = count / 2;
+		std::nth_element(indices.begin(), indices.begin() + mid, indices.end(), [&](uint32_t a, uint32_t b) {
+			return centroids[a][axis] < centroids[b][axis];
+		});
+		node.axis = static_cast<uint8_t>(axis);
+	}
+
+	auto first_child = context.node_count.fetch_add(2, std::memory_order_relaxed);
+	node.offset = first_child;
+	node.primitive_count = 0;
+
+	// Hand the left subtree to a new thread while this one builds the right subtree.
+	// The number of live tasks is capped to the number of hardware threads.
+	auto left_indices = indices.subspan(0, mid);
+	auto right_indices = indices.subspan(mid);
+	auto spawn_task = false;
+	if (mid >= min_task_size && (count - mid) >= min_task_size)
+	{
+		auto active_tasks = context.active_tasks.load(std::memory_order_relaxed);
+		while (active_tasks + 1 < context.thread_count &&
+					 !context.active_tasks.compare_exchange_weak(active_tasks, active_tasks + 1, std::memory_order_relaxed));
+		spawn_task = active_tasks + 1 < context.thread_count;
+	}
+
+	if (spawn_task)
+	{
+		{
+			auto task = std::jthread([&, left_indices]() {
+				__buildRecursive(context, first_child, left_indices, first, depth + 1);
+			});
+			__buildRecursive(context, first_child + 1, right_indices, first + mid, depth + 1);
+		}
+		context.active_tasks.fetch_sub(1, std::memory_order_relaxed);
+	}
+	else
+	{
+		__buildRecursive(context, first_child, left_indices, first, depth + 1);
+		__buildRecursive(context, first_child + 1, right_indices, first + mid, depth + 1);
+	}
+}
@@ -0,0 +1,99 @@
+#include "Accelerator/BVH4.hpp"
+
+#include <limits>
+
+/**
+ * ============================================
+ *		PUBLIC
+ * ============================================
+ */
+
+void BVH4::build(const BVH& bvh)
+{
+	clear();
+	if (!bvh.isBuilt())
+		return;
+
+	// Every 4-wide node replaces at least one binary inner node, so this is an upper bound
+	__nodes.reserve(bvh.getNodes().size() / 2 + 1);
+	__collapse(bvh, 0);
+}
+
+/**
+ * ============================================
+ *		PRIVATE
+ * ============================================
+ */
+
+uint32_t BVH4::__collapse(const BVH& bvh, uint32_t binary_index)
+{
+	const auto& binary_nodes = bvh.getNodes();
+
+	// Open the binary subtree until there are four children: each time, the inner child with
+	// the largest surface area (the one most likely to be hit) is replaced by its two children.
+	uint32_t children[4];
+	auto child_count = 0u;
+	if (binary_nodes[binary_index].isLeaf())
+	{
+		children[child_count++] = binary_index;
+	}
+	else
+	{
+		children[child_count++] = binary_nodes[binary_index].offset;
+		children[child_count++] = binary_nodes[binary_index].offset + 1;
+	}
+	while (child_count < 4)
+	{
+		auto best = -1;
+		auto best_area = -1.f;
+		for (auto i = 0u; i < child_count; ++i)
+		{
+			const auto& node = binary_nodes[children[i]];
+			if (!node.isLeaf() && node.bounds.getSurfaceArea() > best_area)
+			{
+				best = static_cast<int>(i);
+				best_area = node.bounds.getSurfaceArea();
+			}
+		}
+		if (best < 0)
+			break;
+
+		auto first_grandchild = binary_nodes[children[best]].offset;
+		children[best] = first_grandchild;
+		children[child_count++] = first_grandchild + 1;
+	}
+
+	auto node_index = static_cast<uint32_t>(__nodes.size());
+	__nodes.emplace_back();
+	auto node = Node{};
+	node.child_count = child_count;
+	for (auto i = 0u; i < 4; ++i)
+	{
+		auto bounds = i < child_count ? binary_nodes[children[i]].bounds : AABB();
+		for (auto axis = 0; axis < 3; ++axis)
+		{
+			node.bounds_min[axis][i] = bounds.min[axis];
+			node.bounds_max[axis][i] = bounds.max[axis];
+		}
+		node.child[i] = 0u;
+		node.primitive_count[i] = 0u;
+	}
+
+	for (auto i = 0u; i < child_count; ++i)
+	{
+		const auto& child = binary_nodes[children[i]];
+		if (child.isLeaf())
+		{
+			node.child[i] = child.offset;
+			node.primitive_count[i] = child.primitive_count;
+		}
+		else
+		{
+			node.child[i] = __collapse(bvh, children[i]);
+		}
+	}
+
+	// The recursion may have reallocated the array, so the node is written at the end
+	__nodes[node_index] = node;
+	return node_index;
+}
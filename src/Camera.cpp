@@ -1,6 +1,13 @@
 #include "Camera.hpp"
 #include "Ray.hpp"
 #include "Scene.hpp"
+#include "Sampler/IndependentSampler.hpp"
+#include "Sampler/StratifiedSampler.hpp"
+#include "Sampler/SobolSampler.hpp"
+#include "Sampler/BlueNoiseSampler.hpp"
+#include "Sampler/Sampling.hpp"
+#include "WavefrontRenderer.hpp"
+#include "ThreadPool.hpp"
 
 #include "Geometry/IHittableObject.hpp"
 
@@ -9,8 +16,134 @@
 #include <vector>
 #include <thread>
 #include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <limits>
+#include <fstream>
+#include <cstring>
+#include <span>
+#include <type_traits>
 
-#include <glm/gtc/random.hpp>
+namespace
+{
+	constexpr auto checkpoint_magic = uint32_t{ 0x4b435452 }; // "RTCK"
+	constexpr auto checkpoint_version = 4u;
+
+	/**
+	 * @brief
+	 * A checkpoint file is this header followed by the raw per-pixel statistics, in row-major order, then by the
+	 * per-pixel AOV sums if the render gathered any (only the samples rendered with denoising on do).
+	 * The random state does not need to be saved: the samples of a pixel are indexed by the number of samples
+	 * already taken, so a resumed render draws exactly the samples the interrupted one would have.
+	 */
+	struct CheckpointHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint64_t seed;
+		uint64_t fingerprint;	// hash of the scene and of the camera settings (see Camera::__computeFingerprint)
+		uint32_t record_size;	// size of the per-pixel record, guards against layout changes
+		uint32_t auxiliary_record_size;	// size of the per-pixel AOV record, 0 if the file has no AOV sums
+	};
+
+	CheckpointHeader makeCheckpointHeader(const glm::uvec2& resolution,
+																				uint64_t seed,
+																				uint64_t fingerprint,
+																				uint32_t record_size,
+																				uint32_t auxiliary_record_size)
+	{
+		return CheckpointHeader{ checkpoint_magic, checkpoint_version, resolution.x, resolution.y, seed, fingerprint, record_size, auxiliary_record_size };
+	}
+
+	/** @brief FNV-1a hash of a sequence of plain values */
+	struct Fingerprint
+	{
+		template<typename T>
+		void add(const T& data)
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			const auto* bytes = reinterpret_cast<const unsigned char*>(&data);
+			for (auto i = size_t{ 0 }; i < sizeof(T); ++i)
+				value = (value ^ bytes[i]) * 0x100000001b3ULL;
+		}
+
+		uint64_t value = 0xcbf29ce484222325ULL;
+	};
+}
+
+/**
+ * @brief
+ * Saves snapshots of the accumulated samples during a render.
+ * The buffer is copied between passes, while the render threads are idle, and the copy is written to disk
+ * by a background thread while the next pass runs. The file is first written under a temporary name and then
+ * renamed, so an interruption during the write never leaves a truncated checkpoint behind.
+ */
+struct Camera::CheckpointWriter
+{
+	CheckpointWriter(const Camera& camera, uint64_t fingerprint) :
+		camera{ camera },
+		fingerprint{ fingerprint },
+		last_write{ std::chrono::steady_clock::now() }
+	{}
+
+	/** @brief Start writing a snapshot if the checkpoint interval has elapsed since the last one (or if forced) */
+	void update(bool force = false)
+	{
+		if (camera.checkpoint_path.empty())
+			return;
+
+		auto now = std::chrono::steady_clock::now();
+		if (!force && std::chrono::duration<float>(now - last_write).count() < camera.checkpoint_interval)
+			return;
+		last_write = now;
+
+		// Only one write at a time: wait for the previous snapshot to reach the disk
+		if (worker.joinable())
+			worker.join();
+
+		const auto pixel_count = camera.image_resolution.x * camera.image_resolution.y;
+		const auto* statistics = camera.__pixel_statistics.get();
+		auto snapshot = std::vector<PixelStatistics>(statistics, statistics + pixel_count);
+		auto auxiliary_snapshot = std::vector<PixelAuxiliary>();
+		if (camera.__hasAuxiliarySamples())
+			auxiliary_snapshot.assign(camera.__pixel_auxiliary.get(), camera.__pixel_auxiliary.get() + pixel_count);
+		auto auxiliary_record_size = auxiliary_snapshot.empty() ? 0u : static_cast<uint32_t>(sizeof(PixelAuxiliary));
+		auto header = makeCheckpointHeader(camera.image_resolution, camera.seed, fingerprint, sizeof(PixelStatistics), auxiliary_record_size);
+		worker = std::jthread(&CheckpointWriter::write, camera.checkpoint_path, header, std::move(snapshot), std::move(auxiliary_snapshot));
+	}
+
+	static void write(const std::filesystem::path& path,
+										const CheckpointHeader& header,
+										const std::vector<PixelStatistics>& snapshot,
+										const std::vector<PixelAuxiliary>& auxiliary_snapshot)
+	{
+		auto temp_path = path;
+		temp_path += ".tmp";
+		{
+			auto file = std::ofstream(temp_path, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(snapshot.data()), snapshot.size() * sizeof(PixelStatistics));
+			file.write(reinterpret_cast<const char*>(auxiliary_snapshot.data()), auxiliary_snapshot.size() * sizeof(PixelAuxiliary));
+			if (!file)
+			{
+				std::cerr << "Error: cannot write checkpoint " << temp_path << "\n";
+				return;
+			}
+		}
+
+		auto error = std::error_code{};
+		std::filesystem::rename(temp_path, path, error);
+		if (error)
+			std::cerr << "Error: cannot write checkpoint " << path << ": " << error.message() << "\n";
+	}
+
+	const Camera& camera;
+	uint64_t fingerprint;
+	std::chrono::steady_clock::time_point last_write;
+	std::jthread worker;
+};
 
 /** 
  * ============================================
@@ -25,11 +158,33 @@ Camera::Camera(const glm::vec3& position,
 							 const glm::vec2& sensor_size
 ) :
 	position{ position },
-	image_resolution{ image_resolution },
 	sensor_size{ sensor_size },
-	focal_length{ focal_length },
+	image_resolution{ image_resolution },
 	samples_per_pixel{ 128u },
+	samples_per_pass{ 0u },
+	focal_length{ focal_length },
+	aperture_radius{ 0.f },
+	focus_distance{ glm::length(look_at - position) },
+	max_depth{ 10u },
+	russian_roulette_depth{ 3u },
+	seed{ 0u },
+	sampler_type{ SamplerType::SOBOL },
+	integrator{ Integrator::MEGAKERNEL },
+	wavefront_batch_size{ 1u << 18 },
+	light_selection{ LightSelection::ALL },
+	tile_size{ 16u },
+	thread_count{ 0u },
+	adaptive_sampling{ false },
+	min_samples_per_pixel{ 16u },
+	max_samples_per_pixel{ 1024u },
+	adaptive_batch_size{ 16u },
+	adaptive_threshold{ 0.02f },
+	checkpoint_path{},
+	checkpoint_interval{ 60.f },
+	denoising{ false },
+	denoiser{},
 	__renderer{},
+	__wavefront_renderer{},
 	__forward{},
 	__right{},
 	__up{},
@@ -40,73 +195,173 @@ Camera::Camera(const glm::vec3& position,
 	assert(image_resolution.x > 0 && image_resolution.y > 0);
 
 	__image_data = std::make_shared<std::byte[]>(image_resolution.x * image_resolution.y * 3);
+	__pixel_statistics = std::make_shared<PixelStatistics[]>(image_resolution.x * image_resolution.y);
+	__pixel_auxiliary = std::make_shared<PixelAuxiliary[]>(image_resolution.x * image_resolution.y);
 	__computeCameraFrame(look_at);
 	__computeImagingSurface();
 }
 
+// Defined here, where WavefrontRenderer is complete
+Camera::~Camera() = default;
+
 void Camera::captureImage(const Scene& scene) const
 {
-	const auto num_threads = std::thread::hardware_concurrency();
-	std::cout << "Begin execution with " << num_threads << " threads\n";
+	const auto pixel_count = image_resolution.x * image_resolution.y;
+	std::cout << "Begin execution with " << __getThreadCount() << " threads\n";
 	std::cout << "Image resolution: " << image_resolution.x << "x" << image_resolution.y << "\n";
-	std::cout << "Total number of pixel to process: " 
-		<< image_resolution.x * image_resolution.y << "\n";
-	
-	// Initialize the atomic counter with the total number of rays.
-	std::atomic<size_t> remaining_rays = static_cast<size_t>(image_resolution.x) * image_resolution.y * samples_per_pixel;
-	std::cout << "Total number of rays to process: " << remaining_rays << "\n";
-	std::cout << "\rRemaining rays: " << remaining_rays << " " << std::flush;
+	std::cout << "Total number of pixel to process: " << pixel_count << "\n";
 
+	auto checkpoint = CheckpointWriter(*this, __computeFingerprint(scene));
+	if (checkpoint_path.empty() || !__loadCheckpoint(checkpoint.fingerprint))
+		clearImage();
 
-	auto render_chunk = [&](uint32_t start_y, uint32_t end_y) -> void {
-		size_t rays_in_chunk = (end_y - start_y) * image_resolution.x * samples_per_pixel;
-		for (auto y = start_y; y < end_y; ++y)
-		{
-			for (auto x = 0u; x < image_resolution.x; ++x)
-			{
-				auto pixel_color = glm::vec3(0.f);
-				for (auto sample = 0u; sample < samples_per_pixel; sample++)
-				{
-					auto offset = glm::linearRand(glm::vec2(-0.5f), glm::vec2(0.5f));
-					auto ray = __generateRay(x, y, offset);
-					pixel_color += __renderer.computeRayColor(ray, scene, 10);
-				}
-				pixel_color /= static_cast<float>(samples_per_pixel);
-
-				// Conversione e scrittura dei dati.
-				static auto to_byte = [](float c) -> std::byte {
-					return static_cast<std::byte>(glm::clamp(c * 255.999f, 0.0f, 255.0f));
-				};
-				auto r = to_byte(pixel_color.r);
-				auto g = to_byte(pixel_color.g);
-				auto b = to_byte(pixel_color.b);
-				auto index = (y * image_resolution.x + x) * 3;
-				__image_data[index + 0] = r;
-				__image_data[index + 1] = g;
-				__image_data[index + 2] = b;
-			}
-		}
-		// After the chunk is complete, decrement the shared counter by the total rays processed.
-		remaining_rays.fetch_sub(rays_in_chunk);
-		// Print the remaining rays after this thread's work is done.
-		std::cout << "\rRemaining rays: " << remaining_rays << " " << std::flush;
-	};
+	// Samples already taken, when resuming from a checkpoint
+	auto min_taken = std::numeric_limits<uint32_t>::max();
+	auto max_taken = 0u;
+	for (auto i = 0u; i < pixel_count; ++i)
+	{
+		min_taken = glm::min(min_taken, __pixel_statistics[i].sample_count);
+		max_taken = glm::max(max_taken, __pixel_statistics[i].sample_count);
+	}
 
-	auto rows_per_thread = image_resolution.y / num_threads;
 	auto start_time = std::chrono::steady_clock::now();
+	if (!adaptive_sampling)
 	{
-		std::vector<std::jthread> threads;
-		threads.reserve(num_threads);
-		for (auto i = 0u; i < num_threads; ++i)
+		// Progressive passes: the accumulation buffer holds a valid image after each of them
+		const auto pass_samples = samples_per_pass > 0 ? samples_per_pass : samples_per_pixel;
+		for (auto completed = min_taken; completed < samples_per_pixel; completed += pass_samples)
 		{
-			auto start_y = i * rows_per_thread;
-			auto end_y = (i == num_threads - 1) ? image_resolution.y : (i + 1) * rows_per_thread;
-			threads.emplace_back(render_chunk, start_y, end_y);
+			refineImage(scene, glm::min(pass_samples, samples_per_pixel - completed));
+			checkpoint.update();
 		}
 	}
+	else
+	{
+		const auto max_samples = glm::max(max_samples_per_pixel, 2u);
+		const auto min_samples = glm::clamp(min_samples_per_pixel, 2u, max_samples);
+		if (max_taken == 0)
+		{
+			__renderPass(scene, min_samples, nullptr);
+			checkpoint.update();
+			max_taken = min_samples;
+		}
+		__renderAdaptivePasses(scene, max_samples - glm::min(max_taken, max_samples), &checkpoint);
+	}
+	checkpoint.update(true);
 	const auto end_time = std::chrono::steady_clock::now();
 	const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
 	std::cout << "Render complete. Elapsed time: " << duration.count() << " ms" << std::endl;
+
+	if (adaptive_sampling)
+	{
+		auto traced_rays = size_t{ 0 };
+		for (auto i = 0u; i < pixel_count; ++i)
+			traced_rays += __pixel_statistics[i].sample_count;
+		auto average_samples = static_cast<double>(traced_rays) / pixel_count;
+		std::cout << "Adaptive sampling: " << traced_rays << " rays traced, " << average_samples << " samples per pixel on average" << std::endl;
+	}
+}
+
+void Camera::refineImage(const Scene& scene, uint32_t samples) const
+{
+	if (samples == 0)
+		return;
+
+	if (adaptive_sampling)
+		__renderAdaptivePasses(scene, samples);
+	else
+		__renderPass(scene, samples, nullptr);
+}
+
+void Camera::clearImage() const
+{
+	auto pixel_count = image_resolution.x * image_resolution.y;
+	for (auto i = 0u; i < pixel_count; ++i)
+	{
+		__pixel_statistics[i] = PixelStatistics{};
+		__pixel_auxiliary[i] = PixelAuxiliary{};
+	}
+}
+
+void Camera::resolveImage(float gamma) const
+{
+	// Conversione e scrittura dei dati.
+	// Gamma is applied to the float radiance, before quantization, so that dark tones are not lost.
+	static auto to_byte = [](float c) -> std::byte {
+		return static_cast<std::byte>(glm::clamp(c * 255.999f, 0.0f, 255.0f));
+	};
+
+	auto inv_gamma = gamma > 0.f ? 1.f / gamma : 1.f;
+	auto hdr_image = resolveHDRImage();
+	for (auto i = size_t{ 0 }; i < hdr_image.size(); ++i)
+	{
+		auto pixel_color = hdr_image[i];
+		if (inv_gamma != 1.f)
+			pixel_color = glm::pow(glm::max(pixel_color, glm::vec3(0.f)), glm::vec3(inv_gamma));
+
+		__image_data[i * 3 + 0] = to_byte(pixel_color.r);
+		__image_data[i * 3 + 1] = to_byte(pixel_color.g);
+		__image_data[i * 3 + 2] = to_byte(pixel_color.b);
+	}
+}
+
+std::vector<glm::vec3> Camera::resolveHDRImage() const
+{
+	auto pixel_count = image_resolution.x * image_resolution.y;
+	auto hdr_image = std::vector<glm::vec3>(pixel_count);
+	for (auto i = 0u; i < pixel_count; ++i)
+	{
+		const auto& statistics = __pixel_statistics[i];
+		if (statistics.sample_count > 0)
+			hdr_image[i] = statistics.color_sum / static_cast<float>(statistics.sample_count);
+	}
+	if (!denoising)
+		return hdr_image;
+	if (!__hasAuxiliarySamples())
+	{
+		std::cerr << "Warning: no samples were rendered with denoising on, the image is not denoised\n";
+		return hdr_image;
+	}
+
+	auto start_time = std::chrono::steady_clock::now();
+	auto input = DenoiserInput{};
+	input.color = std::move(hdr_image);
+	input.variance.resize(pixel_count);
+	for (auto i = 0u; i < pixel_count; ++i)
+	{
+		// Variance of the mean; with a single sample it is unknown, assume it is as large as the value
+		const auto& statistics = __pixel_statistics[i];
+		auto n = static_cast<float>(statistics.sample_count);
+		input.variance[i] = statistics.sample_count > 1 ? statistics.luminance_m2 / ((n - 1.f) * n) : statistics.luminance_mean * statistics.luminance_mean;
+	}
+	for (const auto& auxiliary : resolveAuxiliaryImage())
+	{
+		input.albedo.push_back(auxiliary.albedo);
+		input.normal.push_back(auxiliary.normal);
+		input.depth.push_back(auxiliary.depth);
+	}
+	auto thread_pool = ThreadPool(__getThreadCount());
+	auto denoised_image = denoiser.denoise(image_resolution, input, thread_pool);
+	const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time);
+	std::cout << "Denoising complete. Elapsed time: " << duration.count() << " ms" << std::endl;
+	return denoised_image;
+}
+
+std::vector<AuxiliarySample> Camera::resolveAuxiliaryImage() const
+{
+	auto pixel_count = image_resolution.x * image_resolution.y;
+	auto auxiliary_image = std::vector<AuxiliarySample>(pixel_count);
+	for (auto i = 0u; i < pixel_count; ++i)
+	{
+		const auto& auxiliary_sums = __pixel_auxiliary[i];
+		if (auxiliary_sums.sample_count == 0)
+			continue;
+		auto inverse_count = 1.f / static_cast<float>(auxiliary_sums.sample_count);
+		auxiliary_image[i].albedo = auxiliary_sums.albedo_sum * inverse_count;
+		auxiliary_image[i].normal = auxiliary_sums.normal_sum * inverse_count;
+		auxiliary_image[i].depth = auxiliary_sums.depth_sum * inverse_count;
+	}
+	return auxiliary_image;
 }
 
 void Camera::applyGammaCorrection(float gamma) const
@@ -138,12 +393,375 @@ void Camera::applyGammaCorrection(float gamma) const
 	}
 }
 
+std::shared_ptr<std::byte[]> Camera::computeSampleCountHeatmap() const
+{
+	auto pixel_count = image_resolution.x * image_resolution.y;
+	auto heatmap = std::make_shared<std::byte[]>(pixel_count * 3);
+	auto max_count = 1u;
+	for (auto i = 0u; i < pixel_count; ++i)
+		max_count = glm::max(max_count, __pixel_statistics[i].sample_count);
+
+	// Black (no samples) -> red -> yellow -> white (max samples)
+	for (auto i = 0u; i < pixel_count; ++i)
+	{
+		auto t = static_cast<float>(__pixel_statistics[i].sample_count) / max_count;
+		auto color = glm::clamp(glm::vec3(t * 3.f, t * 3.f - 1.f, t * 3.f - 2.f), 0.f, 1.f);
+		heatmap[i * 3 + 0] = static_cast<std::byte>(color.r * 255.f);
+		heatmap[i * 3 + 1] = static_cast<std::byte>(color.g * 255.f);
+		heatmap[i * 3 + 2] = static_cast<std::byte>(color.b * 255.f);
+	}
+	return heatmap;
+}
+
 /**
  * ============================================
  *		PRIVATE
  * ============================================
  */
 
+void Camera::__renderPass(const Scene& scene,
+													uint32_t sample_count,
+													const std::vector<uint8_t>* active_pixels) const
+{
+	if (integrator == Integrator::WAVEFRONT)
+	{
+		__renderWavefrontPass(scene, sample_count, active_pixels);
+		return;
+	}
+
+	const auto num_threads = __getThreadCount();
+
+	// Initialize the atomic counter with the total number of rays (an upper bound for adaptive passes).
+	auto pixel_count = static_cast<size_t>(image_resolution.x) * image_resolution.y;
+	if (active_pixels)
+		pixel_count = std::count(active_pixels->begin(), active_pixels->end(), uint8_t{ 1 });
+	std::atomic<size_t> remaining_rays = pixel_count * sample_count;
+	std::cout << "Total number of rays to process: " << remaining_rays << "\n";
+	std::cout << "\rRemaining rays: " << remaining_rays << " " << std::flush;
+
+	// The image is split in small tiles, handed out in order through an atomic counter.
+	// A thread that finishes a cheap tile (e.g. empty sky) immediately picks the next one,
+	// so all threads stay busy until the last tiles are taken.
+	const auto tile_extent = glm::max(tile_size, 1u);
+	const auto tiles_x = (image_resolution.x + tile_extent - 1) / tile_extent;
+	const auto tiles_y = (image_resolution.y + tile_extent - 1) / tile_extent;
+	const auto tile_count = tiles_x * tiles_y;
+	std::atomic<uint32_t> next_tile = 0;
+
+	auto render_tile = [&](uint32_t tile_index, ISampler& sampler) -> void {
+		auto start_x = (tile_index % tiles_x) * tile_extent;
+		auto start_y = (tile_index / tiles_x) * tile_extent;
+		auto end_x = glm::min(start_x + tile_extent, image_resolution.x);
+		auto end_y = glm::min(start_y + tile_extent, image_resolution.y);
+		size_t rays_in_tile = 0;
+		for (auto y = start_y; y < end_y; ++y)
+		{
+			for (auto x = start_x; x < end_x; ++x)
+			{
+				auto pixel_index = static_cast<uint64_t>(y) * image_resolution.x + x;
+				if (active_pixels && !(*active_pixels)[pixel_index])
+					continue;
+				rays_in_tile += sample_count;
+
+				// The samples of a pixel only depend on the pixel and on their index, so the result does not depend on the
+				// thread that renders it. Samples are indexed by the number of samples already taken: every pass takes new ones.
+				auto& statistics = __pixel_statistics[pixel_index];
+				auto* auxiliary_sums = denoising ? &__pixel_auxiliary[pixel_index] : nullptr;
+				for (auto sample = 0u; sample < sample_count; sample++)
+				{
+					sampler.startPixelSample(glm::uvec2(x, y), statistics.sample_count);
+					auto offset = sampler.get2D() - 0.5f;
+					auto ray = __generateRay(x, y, offset, sampler.get2D());
+					auto auxiliary = AuxiliarySample{};
+					auto sample_color = __renderer.computeRayColor(ray, scene, sampler, max_depth, russian_roulette_depth, light_selection,
+																												 auxiliary_sums ? &auxiliary : nullptr);
+					__addSample(statistics, sample_color);
+					if (auxiliary_sums)
+						__addAuxiliarySample(*auxiliary_sums, auxiliary);
+				}
+			}
+		}
+		// After the tile is complete, decrement the shared counter by the total rays processed.
+		remaining_rays.fetch_sub(rays_in_tile);
+	};
+
+	auto render_worker = [&]() -> void {
+		auto sampler = __createSampler();
+		for (auto tile_index = next_tile.fetch_add(1); tile_index < tile_count; tile_index = next_tile.fetch_add(1))
+		{
+			render_tile(tile_index, *sampler);
+			// Print the remaining rays every few tiles.
+			if (tile_index % num_threads == 0)
+				std::cout << "\rRemaining rays: " << remaining_rays << " " << std::flush;
+		}
+	};
+
+	{
+		std::vector<std::jthread> threads;
+		threads.reserve(num_threads);
+		for (auto i = 0u; i < num_threads; ++i)
+			threads.emplace_back(render_worker);
+	}
+	std::cout << "\rRemaining rays: " << remaining_rays << " " << std::flush;
+}
+
+void Camera::__renderWavefrontPass(const Scene& scene,
+																	 uint32_t sample_count,
+																	 const std::vector<uint8_t>* active_pixels) const
+{
+	const auto pixel_count = image_resolution.x * image_resolution.y;
+	auto pixels = std::vector<uint32_t>();
+	for (auto i = 0u; i < pixel_count; ++i)
+		if (!active_pixels || (*active_pixels)[i])
+			pixels.push_back(i);
+
+	auto remaining_rays = static_cast<size_t>(pixels.size()) * sample_count;
+	std::cout << "Total number of rays to process: " << remaining_rays << "\n";
+	std::cout << "\rRemaining rays: " << remaining_rays << " " << std::flush;
+
+	// Batches hold whole pixels, so that the samples of a pixel are accumulated in order
+	const auto pixels_per_batch = glm::max(wavefront_batch_size / glm::max(sample_count, 1u), 1u);
+	const auto thread_count = __getThreadCount();
+	if (!__wavefront_renderer || __wavefront_renderer->getThreadCount() != thread_count)
+		__wavefront_renderer = std::make_unique<WavefrontRenderer>(thread_count);
+	auto& renderer = *__wavefront_renderer;
+	auto sampler = __createSampler();
+	auto rays = std::vector<Ray>();
+	auto path_pixels = std::vector<glm::uvec2>();
+	auto sample_indices = std::vector<uint32_t>();
+	auto radiance = std::vector<glm::vec3>();
+	auto auxiliary = std::vector<AuxiliarySample>();
+	for (auto first = size_t{ 0 }; first < pixels.size(); first += pixels_per_batch)
+	{
+		auto batch_pixels = std::span(pixels).subspan(first, glm::min<size_t>(pixels_per_batch, pixels.size() - first));
+		auto path_count = batch_pixels.size() * sample_count;
+		rays.resize(path_count);
+		path_pixels.resize(path_count);
+		sample_indices.resize(path_count);
+		radiance.resize(path_count);
+		auxiliary.resize(denoising ? path_count : 0u);	// the first hits are only gathered for the denoiser
+
+		// Camera rays, with the same samples as the megakernel: sample k of a pixel is its k-th sample overall
+		for (auto i = size_t{ 0 }; i < batch_pixels.size(); ++i)
+		{
+			auto pixel_index = batch_pixels[i];
+			auto pixel = glm::uvec2(pixel_index % image_resolution.x, pixel_index / image_resolution.x);
+			auto taken = __pixel_statistics[pixel_index].sample_count;
+			for (auto sample = 0u; sample < sample_count; ++sample)
+			{
+				auto path = i * sample_count + sample;
+				path_pixels[path] = pixel;
+				sample_indices[path] = taken + sample;
+				sampler->startPixelSample(pixel, taken + sample);
+				auto offset = sampler->get2D() - 0.5f;
+				rays[path] = __generateRay(static_cast<int>(pixel.x), static_cast<int>(pixel.y), offset, sampler->get2D());
+			}
+		}
+
+		renderer.computeRayColors(rays, path_pixels, sample_indices, scene, *sampler, radiance, max_depth, russian_roulette_depth, light_selection, auxiliary);
+
+		for (auto i = size_t{ 0 }; i < batch_pixels.size(); ++i)
+		{
+			for (auto sample = 0u; sample < sample_count; ++sample)
+			{
+				__addSample(__pixel_statistics[batch_pixels[i]], radiance[i * sample_count + sample]);
+				if (denoising)
+					__addAuxiliarySample(__pixel_auxiliary[batch_pixels[i]], auxiliary[i * sample_count + sample]);
+			}
+		}
+
+		remaining_rays -= path_count;
+		std::cout << "\rRemaining rays: " << remaining_rays << " " << std::flush;
+	}
+}
+
+std::unique_ptr<ISampler> Camera::__createSampler() const
+{
+	// Strata are laid over all the samples of a render
+	auto sample_count = adaptive_sampling ? max_samples_per_pixel : samples_per_pixel;
+	switch (sampler_type)
+	{
+	case SamplerType::INDEPENDENT:	return std::make_unique<IndependentSampler>(seed);
+	case SamplerType::STRATIFIED:		return std::make_unique<StratifiedSampler>(sample_count, seed);
+	case SamplerType::BLUE_NOISE:		return std::make_unique<BlueNoiseSampler>(seed);
+	default:												return std::make_unique<SobolSampler>(seed);
+	}
+}
+
+void Camera::__addSample(PixelStatistics& statistics, const glm::vec3& sample_color)
+{
+	// Running mean and variance of the sample luminance (Welford's method)
+	statistics.color_sum += sample_color;
+	statistics.sample_count++;
+	auto luminance = glm::dot(sample_color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+	auto delta = luminance - statistics.luminance_mean;
+	statistics.luminance_mean += delta / statistics.sample_count;
+	statistics.luminance_m2 += delta * (luminance - statistics.luminance_mean);
+}
+
+void Camera::__addAuxiliarySample(PixelAuxiliary& auxiliary_sums, const AuxiliarySample& auxiliary)
+{
+	auxiliary_sums.albedo_sum += auxiliary.albedo;
+	auxiliary_sums.normal_sum += auxiliary.normal;
+	auxiliary_sums.depth_sum += auxiliary.depth;
+	auxiliary_sums.sample_count++;
+}
+
+bool Camera::__hasAuxiliarySamples() const
+{
+	const auto pixel_count = image_resolution.x * image_resolution.y;
+	return std::any_of(__pixel_auxiliary.get(), __pixel_auxiliary.get() + pixel_count,
+										 [](const PixelAuxiliary& auxiliary_sums) { return auxiliary_sums.sample_count > 0; });
+}
+
+void Camera::__renderAdaptivePasses(const Scene& scene, uint32_t sample_budget, CheckpointWriter* checkpoint) const
+{
+	// A pixel stays active while its own error, or the error of one of its neighbors, is above the threshold.
+	// Looking at the neighborhood protects pixels whose first samples all missed a rare but bright path
+	// (e.g. a small light seen through indirect bounces), which would otherwise look converged with zero variance.
+	// Every pass adds the same number of samples to all active pixels, so no pixel exceeds the budget.
+	const auto pixel_count = image_resolution.x * image_resolution.y;
+	auto errors = std::vector<float>(pixel_count);
+	auto active_pixels = std::vector<uint8_t>(pixel_count);
+	auto pass = 1u;
+	for (auto added = 0u; added < sample_budget; ++pass)
+	{
+		for (auto i = 0u; i < pixel_count; ++i)
+			errors[i] = __estimatePixelError(__pixel_statistics[i]);
+
+		auto active_count = 0u;
+		for (auto y = 0u; y < image_resolution.y; ++y)
+		{
+			for (auto x = 0u; x < image_resolution.x; ++x)
+			{
+				auto neighborhood_error = 0.f;
+				for (auto ny = (y > 0 ? y - 1 : 0u); ny <= glm::min(y + 1, image_resolution.y - 1); ++ny)
+					for (auto nx = (x > 0 ? x - 1 : 0u); nx <= glm::min(x + 1, image_resolution.x - 1); ++nx)
+						neighborhood_error = glm::max(neighborhood_error, errors[ny * image_resolution.x + nx]);
+
+				auto is_active = neighborhood_error > adaptive_threshold;
+				active_pixels[y * image_resolution.x + x] = is_active;
+				active_count += is_active;
+			}
+		}
+		if (active_count == 0)
+			break;
+
+		auto batch = glm::min(glm::max(adaptive_batch_size, 1u), sample_budget - added);
+		std::cout << "Adaptive pass " << pass << ": " << active_count << " active pixels\n";
+		__renderPass(scene, batch, &active_pixels);
+		added += batch;
+		if (checkpoint)
+			checkpoint->update();
+	}
+}
+
+uint32_t Camera::__getThreadCount() const
+{
+	return thread_count > 0 ? thread_count : std::max(1u, std::thread::hardware_concurrency());
+}
+
+/**
+ * The pixel value is the mean of its samples, so its error is estimated by the standard error of the mean:
+ * se = sqrt(s^2 / n), with s^2 = M2 / (n - 1) the sample variance.
+ * The error is measured relative to the pixel brightness, since the same absolute noise is much more visible
+ * in dark regions than in bright ones; a small constant keeps black pixels from requiring an exact zero variance.
+ */
+float Camera::__estimatePixelError(const PixelStatistics& statistics) const
+{
+	if (statistics.sample_count < 2)
+		return std::numeric_limits<float>::infinity();
+
+	auto n = static_cast<float>(statistics.sample_count);
+	auto variance = statistics.luminance_m2 / (n - 1.f);
+	auto standard_error = glm::sqrt(variance / n);
+	return standard_error / (statistics.luminance_mean + 1e-2f);
+}
+
+/**
+ * @brief
+ * The settings that change the accumulated estimate: the view, the integrator parameters and the sample targets
+ * (the stratified sampler, for one, spreads its strata over the samples of the whole render). The scene is
+ * summarized by the bounds, area and material parameters of its objects, in insertion order; textures are not hashed.
+ * Settings that only change how the work is scheduled (threads, tiles, integrator kind, passes) are left out.
+ */
+uint64_t Camera::__computeFingerprint(const Scene& scene) const
+{
+	auto fingerprint = Fingerprint{};
+	fingerprint.add(position);
+	fingerprint.add(__forward);
+	fingerprint.add(__up);
+	fingerprint.add(sensor_size);
+	fingerprint.add(focal_length);
+	fingerprint.add(aperture_radius);
+	fingerprint.add(focus_distance);
+	fingerprint.add(max_depth);
+	fingerprint.add(russian_roulette_depth);
+	fingerprint.add(sampler_type);
+	fingerprint.add(light_selection);
+	fingerprint.add(adaptive_sampling);
+	if (adaptive_sampling)
+	{
+		fingerprint.add(min_samples_per_pixel);
+		fingerprint.add(max_samples_per_pixel);
+		fingerprint.add(adaptive_batch_size);
+		fingerprint.add(adaptive_threshold);
+	}
+	else
+		fingerprint.add(samples_per_pixel);
+
+	fingerprint.add(scene.getObjects().size());
+	for (const auto& object : scene.getObjects())
+	{
+		auto bounds = object->getBoundingBox();
+		fingerprint.add(bounds.min);
+		fingerprint.add(bounds.max);
+		fingerprint.add(object->getSurfaceArea());
+		if (const auto& material = object->getMaterial())
+		{
+			fingerprint.add(material->color_scale);
+			fingerprint.add(material->emission_scale);
+			fingerprint.add(material->roughness_scale);
+		}
+	}
+	return fingerprint.value;
+}
+
+bool Camera::__loadCheckpoint(uint64_t fingerprint) const
+{
+	auto file = std::ifstream(checkpoint_path, std::ios::binary);
+	if (!file)
+		return false;
+
+	auto header = CheckpointHeader{};
+	auto expected_header = makeCheckpointHeader(image_resolution, seed, fingerprint, sizeof(PixelStatistics), sizeof(PixelAuxiliary));
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+	// The AOV sums are optional: a render without denoising does not save them
+	if (header.auxiliary_record_size == 0)
+		expected_header.auxiliary_record_size = 0;
+	if (!file || std::memcmp(&header, &expected_header, sizeof(header)) != 0)
+	{
+		std::cerr << "Warning: checkpoint " << checkpoint_path << " does not match this scene and camera, starting from scratch\n";
+		return false;
+	}
+
+	const auto pixel_count = image_resolution.x * image_resolution.y;
+	file.read(reinterpret_cast<char*>(__pixel_statistics.get()), static_cast<std::streamsize>(pixel_count) * sizeof(PixelStatistics));
+	for (auto i = 0u; i < pixel_count; ++i)
+		__pixel_auxiliary[i] = PixelAuxiliary{};
+	if (header.auxiliary_record_size > 0)
+		file.read(reinterpret_cast<char*>(__pixel_auxiliary.get()), static_cast<std::streamsize>(pixel_count) * sizeof(PixelAuxiliary));
+	if (!file)
+	{
+		std::cerr << "Warning: checkpoint " << checkpoint_path << " is truncated, starting from scratch\n";
+		return false;
+	}
+
+	std::cout << "Resuming from checkpoint " << checkpoint_path << "\n";
+	return true;
+}
+
 void Camera::__computeCameraFrame(const glm::vec3& target)
 {
 	__forward = glm::normalize(target - position);
@@ -159,12 +777,20 @@ void Camera::__computeImagingSurface()
 	__top_left_corner = image_center - (__sensor_width_vector * 0.5f) + (__sensor_height_vector * 0.5f);
 }
 
-Ray Camera::__generateRay(int x, int y, glm::vec2& offset) const
+Ray Camera::__generateRay(int x, int y, const glm::vec2& offset, const glm::vec2& lens_u) const
 {
 	auto u = (static_cast<float>(x) + 0.5f + offset.x) / image_resolution.x;
 	auto v = 1.0f - (static_cast<float>(y) + 0.5f + offset.y) / image_resolution.y;
 	auto image_point = __top_left_corner + (u * __sensor_width_vector) - (v * __sensor_height_vector);
 	auto ray_dir = glm::normalize(image_point - position);
-	return Ray(position, ray_dir);
+	if (aperture_radius <= 0.f)
+		return Ray(position, ray_dir);
+
+	// Thin lens: the rays through every point of the lens converge where the pinhole ray meets the plane of focus.
+	// lens_u is drawn even for a pinhole, so the next dimensions of the sample do not depend on the aperture.
+	auto focus_point = position + ray_dir * (focus_distance / glm::dot(ray_dir, __forward));
+	auto lens_point = aperture_radius * sampleUniformDisk(lens_u);
+	auto origin = position + lens_point.x * __right + lens_point.y * __up;
+	return Ray(origin, glm::normalize(focus_point - origin));
 }
 
@@ -0,0 +1,53 @@
+#include "CompiledScene.hpp"
+
+#include <typeinfo>
+
+/**
+ * ============================================
+ *		PUBLIC
+ * ============================================
+ */
+
+void CompiledScene::build(const std::vector<std::shared_ptr<IHittableObject>>& objects, std::span<const uint32_t> slot_order)
+{
+	clear();
+	__primitives.reserve(slot_order.size());
+	for (auto index : slot_order)
+	{
+		const auto& object = *objects[index];
+		if (typeid(object) == typeid(Sphere))
+		{
+			__primitives.push_back(PrimitiveRef{ PrimitiveType::SPHERE, static_cast<uint32_t>(__spheres.size()) });
+			__spheres.push_back(static_cast<const Sphere&>(object));
+		}
+		else if (typeid(object) == typeid(Plane))
+		{
+			__primitives.push_back(PrimitiveRef{ PrimitiveType::PLANE, static_cast<uint32_t>(__planes.size()) });
+			__planes.push_back(static_cast<const Plane&>(object));
+		}
+		else
+		{
+			__primitives.push_back(PrimitiveRef{ PrimitiveType::OBJECT, static_cast<uint32_t>(__objects.size()) });
+			__objects.push_back(&object);
+		}
+	}
+}
+
+void CompiledScene::clear()
+{
+	__primitives.clear();
+	__spheres.clear();
+	__planes.clear();
+	__objects.clear();
+}
+
+const IHittableObject& CompiledScene::getObject(uint32_t slot) const
+{
+	auto primitive = __primitives[slot];
+	switch (primitive.type)
+	{
+	case PrimitiveType::SPHERE:	return __spheres[primitive.index];
+	case PrimitiveType::PLANE:	return __planes[primitive.index];
+	default:										return *__objects[primitive.index];
+	}
+}
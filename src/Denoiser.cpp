@@ -0,0 +1,248 @@
+#include "Denoiser.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+
+#include <utility>
+#include <cassert>
+
+namespace
+{
+	using namespace simd;
+
+	constexpr float kernel[5] = { 1.f / 16.f, 1.f / 4.f, 3.f / 8.f, 1.f / 4.f, 1.f / 16.f };	// B3 spline
+	const auto luminance_weights = glm::vec3(0.2126f, 0.7152f, 0.0722f);
+	constexpr auto min_albedo = 1e-3f;						// keeps the division by the albedo finite on black surfaces
+	constexpr auto min_color_tolerance = 1e-4f;		// pixels without noise only accept neighbors of the same luminance
+	constexpr auto min_depth_tolerance = 1e-3f;
+
+	/**
+	 * @brief
+	 * exp(-x) for x >= 0, approximated by (1 + x / 8)^-8: only multiplications and a division, which every SIMD width has.
+	 * The error is below 0.01 in absolute value, and the approximation decays polynomially instead of exponentially,
+	 * which does not matter for weights that are negligible either way.
+	 */
+	inline FloatN negativeExp(FloatN x)
+	{
+		auto y = add(broadcast(1.f), mul(x, broadcast(0.125f)));
+		y = mul(y, y);
+		y = mul(y, y);
+		y = mul(y, y);
+		return div(broadcast(1.f), y);
+	}
+
+	/**
+	 * @brief
+	 * One channel of an image, with its rows padded on both sides: a SIMD load at any tap of the filter stays
+	 * in the buffer. The padding is never used, the taps outside the image get a zero weight.
+	 */
+	struct Plane
+	{
+		Plane(const glm::uvec2& resolution, uint32_t padding) :
+			stride{ resolution.x + 2 * padding },
+			padding{ padding },
+			values(static_cast<size_t>(stride) * resolution.y, 0.f)
+		{}
+
+		float* row(uint32_t y) { return values.data() + static_cast<size_t>(y) * stride + padding; }
+		const float* row(uint32_t y) const { return values.data() + static_cast<size_t>(y) * stride + padding; }
+
+		uint32_t stride;
+		uint32_t padding;
+		std::vector<float> values;
+	};
+
+	/** @brief The filtered quantities: the illumination (color divided by albedo) and the variance of its luminance */
+	struct Signal
+	{
+		Signal(const glm::uvec2& resolution, uint32_t padding) :
+			r{ resolution, padding }, g{ resolution, padding }, b{ resolution, padding }, variance{ resolution, padding }
+		{}
+
+		Plane r, g, b, variance;
+	};
+
+	/** @brief The edge-stopping buffers, and the depth gradient of each pixel */
+	struct Guide
+	{
+		Guide(const glm::uvec2& resolution, uint32_t padding) :
+			normal_x{ resolution, padding }, normal_y{ resolution, padding }, normal_z{ resolution, padding },
+			depth{ resolution, padding }, depth_gradient_x{ resolution, padding }, depth_gradient_y{ resolution, padding }
+		{}
+
+		Plane normal_x, normal_y, normal_z, depth, depth_gradient_x, depth_gradient_y;
+	};
+
+	inline FloatN luminance(FloatN r, FloatN g, FloatN b)
+	{
+		return add(add(mul(r, broadcast(luminance_weights.r)), mul(g, broadcast(luminance_weights.g))), mul(b, broadcast(luminance_weights.b)));
+	}
+
+	/** @brief Depth difference to the nearest neighbor, on the side where it is the smallest (a silhouette is not a slope) */
+	float computeDepthGradient(float previous, float center, float next)
+	{
+		auto backward = center - previous;
+		auto forward = next - center;
+		return glm::abs(backward) < glm::abs(forward) ? backward : forward;
+	}
+
+	/** @brief One a-trous iteration on row y, with taps step pixels apart */
+	void filterRow(const Denoiser& settings,
+								 const glm::uvec2& resolution,
+								 const Guide& guide,
+								 const Signal& input,
+								 Signal& output,
+								 uint32_t y,
+								 uint32_t step)
+	{
+		const auto width = static_cast<float>(resolution.x);
+		const auto color_sigma = broadcast(settings.color_sigma);
+		const auto half_normal_sigma = broadcast(0.5f * settings.normal_sigma);
+		for (auto x = 0u; x < resolution.x; x += simd_width)
+		{
+			auto center_r = load(input.r.row(y) + x);
+			auto center_g = load(input.g.row(y) + x);
+			auto center_b = load(input.b.row(y) + x);
+			auto center_luminance = luminance(center_r, center_g, center_b);
+			auto center_variance = load(input.variance.row(y) + x);
+			auto center_normal_x = load(guide.normal_x.row(y) + x);
+			auto center_normal_y = load(guide.normal_y.row(y) + x);
+			auto center_normal_z = load(guide.normal_z.row(y) + x);
+			auto center_depth = load(guide.depth.row(y) + x);
+			auto depth_slope_x = mul(abs(load(guide.depth_gradient_x.row(y) + x)), broadcast(settings.depth_sigma * step));
+			auto depth_slope_y = mul(abs(load(guide.depth_gradient_y.row(y) + x)), broadcast(settings.depth_sigma * step));
+			auto lane_x = add(laneOffsets(), broadcast(static_cast<float>(x)));
+
+			auto weight_sum = broadcast(0.f);
+			auto sum_r = broadcast(0.f);
+			auto sum_g = broadcast(0.f);
+			auto sum_b = broadcast(0.f);
+			auto sum_variance = broadcast(0.f);
+			for (auto dy = -2; dy <= 2; ++dy)
+			{
+				auto tap_y = static_cast<int>(y) + dy * static_cast<int>(step);
+				if (tap_y < 0 || tap_y >= static_cast<int>(resolution.y))
+					continue;
+				auto row = static_cast<uint32_t>(tap_y);
+				for (auto dx = -2; dx <= 2; ++dx)
+				{
+					auto offset = static_cast<int>(x) + dx * static_cast<int>(step);
+					auto tap_x = add(lane_x, broadcast(static_cast<float>(dx * static_cast<int>(step))));
+					auto inside = logicalAnd(greaterEqual(tap_x, broadcast(0.f)), lessThan(tap_x, broadcast(width)));
+					if (!any(inside))
+						continue;
+
+					auto r = load(input.r.row(row) + offset);
+					auto g = load(input.g.row(row) + offset);
+					auto b = load(input.b.row(row) + offset);
+					auto variance = load(input.variance.row(row) + offset);
+
+					// Luminance: the difference, against the standard deviation of the difference of two independent estimates
+					auto color_tolerance = add(mul(color_sigma, sqrt(add(center_variance, variance))), broadcast(min_color_tolerance));
+					auto exponent = div(abs(sub(luminance(r, g, b), center_luminance)), color_tolerance);
+
+					// Normal: exp(-sigma * |n - n'|^2 / 2), which is exp(-sigma * (1 - cos)) for unit normals, close to the cos^sigma
+					// of the paper. Pixels without a hit have a zero normal: they match each other, and nothing else.
+					auto normal_dx = sub(center_normal_x, load(guide.normal_x.row(row) + offset));
+					auto normal_dy = sub(center_normal_y, load(guide.normal_y.row(row) + offset));
+					auto normal_dz = sub(center_normal_z, load(guide.normal_z.row(row) + offset));
+					auto normal_distance = add(add(mul(normal_dx, normal_dx), mul(normal_dy, normal_dy)), mul(normal_dz, normal_dz));
+					exponent = add(exponent, mul(half_normal_sigma, normal_distance));
+
+					// Depth: the difference, against the one the slope of the center surface predicts at that distance
+					auto depth_tolerance = add(add(mul(depth_slope_x, broadcast(static_cast<float>(glm::abs(dx)))),
+																				 mul(depth_slope_y, broadcast(static_cast<float>(glm::abs(dy))))),
+																		 broadcast(min_depth_tolerance));
+					exponent = add(exponent, div(abs(sub(load(guide.depth.row(row) + offset), center_depth)), depth_tolerance));
+
+					auto weight = mul(broadcast(kernel[dx + 2] * kernel[dy + 2]), negativeExp(exponent));
+					weight = select(inside, weight, broadcast(0.f));
+					weight_sum = add(weight_sum, weight);
+					sum_r = add(sum_r, mul(weight, r));
+					sum_g = add(sum_g, mul(weight, g));
+					sum_b = add(sum_b, mul(weight, b));
+					sum_variance = add(sum_variance, mul(mul(weight, weight), variance));
+				}
+			}
+
+			// Lanes past the end of the row can have no tap inside the image: keep them finite
+			auto inverse_weight = div(broadcast(1.f), max(weight_sum, broadcast(1e-6f)));
+			store(output.r.row(y) + x, mul(sum_r, inverse_weight));
+			store(output.g.row(y) + x, mul(sum_g, inverse_weight));
+			store(output.b.row(y) + x, mul(sum_b, inverse_weight));
+			store(output.variance.row(y) + x, mul(sum_variance, mul(inverse_weight, inverse_weight)));
+		}
+	}
+
+	constexpr auto rows_per_chunk = 4u;
+}
+
+/**
+ * ============================================
+ *		PUBLIC
+ * ============================================
+ */
+
+std::vector<glm::vec3> Denoiser::denoise(const glm::uvec2& resolution, const DenoiserInput& input, ThreadPool& thread_pool) const
+{
+	const auto pixel_count = static_cast<size_t>(resolution.x) * resolution.y;
+	assert(input.color.size() == pixel_count && input.variance.size() == pixel_count && input.albedo.size() == pixel_count &&
+				 input.normal.size() == pixel_count && input.depth.size() == pixel_count);
+	if (pixel_count == 0 || iterations == 0)
+		return input.color;
+
+	// Widest tap, plus the lanes of the last load of a row
+	const auto max_step = 1u << (iterations - 1);
+	const auto padding = 2 * max_step + simd_width;
+	const auto albedo = [&](size_t i) { return glm::max(input.albedo[i], glm::vec3(min_albedo)); };
+
+	auto guide = Guide(resolution, padding);
+	auto signal = Signal(resolution, padding);
+	auto filtered = Signal(resolution, padding);
+	thread_pool.parallelFor(resolution.y, rows_per_chunk, [&](uint32_t y) {
+		for (auto x = 0u; x < resolution.x; ++x)
+		{
+			auto i = static_cast<size_t>(y) * resolution.x + x;
+			auto illumination = input.color[i] / albedo(i);
+			signal.r.row(y)[x] = illumination.r;
+			signal.g.row(y)[x] = illumination.g;
+			signal.b.row(y)[x] = illumination.b;
+			auto albedo_luminance = glm::dot(albedo(i), luminance_weights);
+			signal.variance.row(y)[x] = input.variance[i] / (albedo_luminance * albedo_luminance);
+
+			// The mean normal of a pixel on a silhouette is shorter than 1: only its direction is compared
+			auto normal = input.normal[i];
+			if (glm::dot(normal, normal) > 0.f)
+				normal = glm::normalize(normal);
+			guide.normal_x.row(y)[x] = normal.x;
+			guide.normal_y.row(y)[x] = normal.y;
+			guide.normal_z.row(y)[x] = normal.z;
+			guide.depth.row(y)[x] = input.depth[i];
+
+			auto depth = [&](uint32_t px, uint32_t py) { return input.depth[static_cast<size_t>(py) * resolution.x + px]; };
+			auto left = x > 0 ? x - 1 : x;
+			auto right = x + 1 < resolution.x ? x + 1 : x;
+			auto up = y > 0 ? y - 1 : y;
+			auto down = y + 1 < resolution.y ? y + 1 : y;
+			guide.depth_gradient_x.row(y)[x] = computeDepthGradient(depth(left, y), depth(x, y), depth(right, y));
+			guide.depth_gradient_y.row(y)[x] = computeDepthGradient(depth(x, up), depth(x, y), depth(x, down));
+		}
+	});
+
+	for (auto iteration = 0u; iteration < iterations; ++iteration)
+	{
+		thread_pool.parallelFor(resolution.y, rows_per_chunk, [&](uint32_t y) {
+			filterRow(*this, resolution, guide, signal, filtered, y, 1u << iteration);
+		});
+		std::swap(signal, filtered);
+	}
+
+	auto output = std::vector<glm::vec3>(pixel_count);
+	thread_pool.parallelFor(resolution.y, rows_per_chunk, [&](uint32_t y) {
+		for (auto x = 0u; x < resolution.x; ++x)
+		{
+			auto i = static_cast<size_t>(y) * resolution.x + x;
+			output[i] = glm::vec3(signal.r.row(y)[x], signal.g.row(y)[x], signal.b.row(y)[x]) * albedo(i);
+		}
+	});
+	return output;
+}
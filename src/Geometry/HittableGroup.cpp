@@ -0,0 +1,97 @@
+#include "Geometry/HittableGroup.hpp"
+#include "Ray.hpp"
+
+#include <cassert>
+#include <limits>
+#include <algorithm>
+#include <glm/gtx/norm.hpp> // glm::length2
+
+HittableGroup::HittableGroup(std::vector<std::shared_ptr<IHittableObject>> objects) :
+	IHittableObject(glm::vec3(0.f), nullptr),
+	__objects{ std::move(objects) },
+	__instance_depth{ 0 }
+{
+	assert(!__objects.empty());
+
+	auto bounds = std::vector<AABB>();
+	bounds.reserve(__objects.size());
+	for (const auto& object : __objects)
+		bounds.push_back(object->getBoundingBox());
+	__bvh.build(bounds);
+
+	__bvh_objects.reserve(__objects.size());
+	for (auto index : __bvh.getPrimitiveIndices())
+		__bvh_objects.push_back(__objects[index].get());
+	__position = __bvh.getBounds().getCentroid();
+
+	for (const auto& object : __objects)
+		__instance_depth = std::max(__instance_depth, object->getInstanceDepth());
+}
+
+bool HittableGroup::intersect(const Ray& ray,
+															float t_min,
+															float t_max,
+															HitRecord& hit) const
+{
+	return __bvh.intersect(ray, t_min, t_max, [&](uint32_t slot, float t_near, float& t_far) -> bool {
+		if (!__bvh_objects[slot]->intersect(ray, t_near, t_far, hit))
+			return false;
+		t_far = hit.t;
+		return true;
+	});
+}
+
+void HittableGroup::computeSurfaceInteraction(const Ray& ray,
+																							HitRecord& hit) const
+{
+	// The group adds nothing to the surface: the hit is resolved by the member that was hit
+	hit.getNextObject()->computeSurfaceInteraction(ray, hit);
+}
+
+bool HittableGroup::occludes(const Ray& ray,
+														 float t_min,
+														 float t_max) const
+{
+	return __bvh.occluded(ray, t_min, t_max, [&](uint32_t slot, float t_near, float t_far) -> bool {
+		return __bvh_objects[slot]->occludes(ray, t_near, t_far);
+	});
+}
+
+void HittableGroup::collectMaterials(std::vector<const IMaterial*>& materials) const
+{
+	for (const auto& object : __objects)
+		object->collectMaterials(materials);
+}
+
+void HittableGroup::assignMaterialIds(const MaterialTable& materials) const
+{
+	for (const auto& object : __objects)
+		object->assignMaterialIds(materials);
+}
+
+glm::vec3 HittableGroup::getNormal(const glm::vec3& p) const
+{
+	return __findClosestObject(p)->getNormal(p);
+}
+
+glm::vec2 HittableGroup::getTextureCoordinates(const glm::vec3& p) const
+{
+	return __findClosestObject(p)->getTextureCoordinates(p);
+}
+
+const IHittableObject* HittableGroup::__findClosestObject(const glm::vec3& p) const
+{
+	const IHittableObject* closest_object = __objects.front().get();
+	auto closest_distance2 = std::numeric_limits<float>::infinity();
+	for (const auto& object : __objects)
+	{
+		auto bounds = object->getBoundingBox();
+		auto distance2 = glm::length2(p - glm::clamp(p, bounds.min, bounds.max));
+		if (distance2 < closest_distance2)
+		{
+			closest_distance2 = distance2;
+			closest_object = object.get();
+		}
+	}
+	return closest_object;
+}
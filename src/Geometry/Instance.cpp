@@ -0,0 +1,118 @@
+#include "Geometry/Instance.hpp"
+#include "Ray.hpp"
+
+#include <cassert>
+#include <stdexcept>
+
+Instance::Instance(std::shared_ptr<const IHittableObject> object,
+									 const glm::mat4& transform,
+									 const std::shared_ptr<IMaterial>& material) :
+	IHittableObject(glm::vec3(transform * glm::vec4(object->getPosition(), 1.f)), material ? material : object->getMaterial()),
+	__object{ std::move(object) },
+	__transform{ transform },
+	__inverse_transform{ glm::inverse(transform) },
+	__normal_matrix{ glm::transpose(glm::mat3(__inverse_transform)) },
+	__bounds{},
+	__override_material{ material != nullptr }
+{
+	// World bounds: the box around the eight transformed corners of the local box
+	auto local_bounds = __object->getBoundingBox();
+	assert(!local_bounds.isEmpty());
+	// A hit records every instance it goes through, so deeper nestings cannot be represented
+	if (getInstanceDepth() > HitRecord::MAX_INSTANCE_DEPTH)
+		throw std::invalid_argument("Instance: more nested instances than HitRecord::MAX_INSTANCE_DEPTH");
+	for (auto corner = 0; corner < 8; ++corner)
+	{
+		auto p = glm::vec3(
+			corner & 1 ? local_bounds.max.x : local_bounds.min.x,
+			corner & 2 ? local_bounds.max.y : local_bounds.min.y,
+			corner & 4 ? local_bounds.max.z : local_bounds.min.z
+		);
+		__bounds.expand(glm::vec3(__transform * glm::vec4(p, 1.f)));
+	}
+}
+
+bool Instance::intersect(const Ray& ray,
+												 float t_min,
+												 float t_max,
+												 HitRecord& hit) const
+{
+	auto distance_scale = 1.f;
+	auto local_ray = __toLocalRay(ray, distance_scale);
+	if (!__object->intersect(local_ray, t_min * distance_scale, t_max * distance_scale, hit))
+		return false;
+
+	hit.t /= distance_scale;
+	hit.instances[hit.instance_count++] = this;
+	return true;
+}
+
+void Instance::computeSurfaceInteraction(const Ray& ray,
+																				 HitRecord& hit) const
+{
+	// This instance is the outermost unresolved one: pop it, then let the next object on the path
+	// resolve the hit in the local space, and bring the result back.
+	assert(hit.instance_count > 0 && hit.instances[hit.instance_count - 1] == this);
+	--hit.instance_count;
+
+	auto distance_scale = 1.f;
+	auto local_ray = __toLocalRay(ray, distance_scale);
+	auto t = hit.t;
+	hit.t = t * distance_scale;
+	hit.getNextObject()->computeSurfaceInteraction(local_ray, hit);
+
+	hit.t = t;
+	hit.point = ray.at(t);
+	hit.normal = glm::normalize(__normal_matrix * hit.normal);
+	if (__override_material)
+	{
+		hit.material = __material.get();
+		hit.material_id = __material_id;
+		hit.light_id = __light_id;
+	}
+}
+
+bool Instance::occludes(const Ray& ray,
+												float t_min,
+												float t_max) const
+{
+	auto distance_scale = 1.f;
+	auto local_ray = __toLocalRay(ray, distance_scale);
+	return __object->occludes(local_ray, t_min * distance_scale, t_max * distance_scale);
+}
+
+void Instance::collectMaterials(std::vector<const IMaterial*>& materials) const
+{
+	if (__override_material)
+		materials.push_back(__material.get());
+	else
+		__object->collectMaterials(materials);
+}
+
+void Instance::assignMaterialIds(const MaterialTable& materials) const
+{
+	if (__override_material)
+		IHittableObject::assignMaterialIds(materials);
+	else
+		__object->assignMaterialIds(materials);
+}
+
+glm::vec3 Instance::getNormal(const glm::vec3& p) const
+{
+	auto local_p = glm::vec3(__inverse_transform * glm::vec4(p, 1.f));
+	return glm::normalize(__normal_matrix * __object->getNormal(local_p));
+}
+
+glm::vec2 Instance::getTextureCoordinates(const glm::vec3& p) const
+{
+	auto local_p = glm::vec3(__inverse_transform * glm::vec4(p, 1.f));
+	return __object->getTextureCoordinates(local_p);
+}
+
+Ray Instance::__toLocalRay(const Ray& ray, float& distance_scale) const
+{
+	auto local_origin = glm::vec3(__inverse_transform * glm::vec4(ray.origin, 1.f));
+	auto local_direction = glm::mat3(__inverse_transform) * ray.direction;
+	distance_scale = glm::length(local_direction);
+	return Ray(local_origin, local_direction);
+}
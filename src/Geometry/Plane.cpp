@@ -3,6 +3,28 @@
 
 #include <glm/gtx/norm.hpp> // glm::length2
 
+Plane::Plane(const glm::vec3& position,
+						 const std::shared_ptr<IMaterial>& material,
+						 glm::vec3 orientation,
+						 float width,
+						 float height
+) :
+	IHittableObject(position, material),
+	__orientation{ orientation },
+	__tangent{},
+	__bitangent{},
+	__width{ width },
+	__height{ height }
+{
+	// Calculate once a stable orthogonal basis (tangent and bitangent) for the plane.
+	auto n = __orientation;
+	if (glm::abs(n.x) > glm::abs(n.y))
+		__tangent = glm::normalize(glm::vec3(n.z, 0.0f, -n.x));
+	else
+		__tangent = glm::normalize(glm::vec3(0.0f, -n.z, n.y));
+	__bitangent = glm::cross(n, __tangent);
+}
+
 bool Plane::intersect(const Ray& ray,
 											float t_min,
 											float t_max,
@@ -41,33 +63,58 @@ bool Plane::intersect(const Ray& ray,
 	if (t < t_min || t > t_max)
 		return false;
 
-	auto hit_point = ray.at(t);
-	auto local_coords = this->getTextureCoordinates(hit_point);
+	auto local_coords = this->getTextureCoordinates(ray.at(t));
 	// Check if the hit point is within the finite dimensions of the plane.
 	if (glm::abs(local_coords.x) > (__width / 2.0f) || glm::abs(local_coords.y) > (__height / 2.0f))
 		return false;
 
-	// Normalize texture coordinates to be in the [0, 1] range and handle wrapping.
-	local_coords.x = (local_coords.x / __width) + 0.5f;
-	local_coords.y = (local_coords.y / __height) + 0.5f;
-
 	hit.t = t;
-	hit.tc_u = local_coords.x;
-	hit.tc_v = local_coords.y;
-	hit.point = hit_point;
-	hit.material = this->__material;
+	hit.object = this;
+	hit.primitive_id = 0;
+	hit.primitive_uv = local_coords;	// kept for the texture coordinates
+	hit.instance_count = 0;
+	return true;
+}
+
+void Plane::computeSurfaceInteraction(const Ray& ray,
+																			HitRecord& hit) const
+{
+	// Normalize texture coordinates to be in the [0, 1] range and handle wrapping.
+	hit.tc_u = (hit.primitive_uv.x / __width) + 0.5f;
+	hit.tc_v = (hit.primitive_uv.y / __height) + 0.5f;
+	hit.point = ray.at(hit.t);
+	hit.material = this->__material.get();
+	hit.material_id = this->__material_id;
+	hit.light_id = this->__light_id;
 	
-	if (glm::dot(ray.direction, n) < 0)
+	if (glm::dot(ray.direction, __orientation) < 0)
 	{
 		hit.is_ray_outside = true;
-		hit.normal = n;
+		hit.normal = __orientation;
 	}
 	else
 	{
 		hit.is_ray_outside = false;
-		hit.normal = -n;
+		hit.normal = -__orientation;
 	}
-	return true;
+}
+
+bool Plane::occludes(const Ray& ray,
+										 float t_min,
+										 float t_max) const
+{
+	// Same test as intersect, stopping as soon as the hit point is known to lie on the finite plane.
+	auto denom = glm::dot(ray.direction, __orientation);
+	if (glm::abs(denom) < 1e-6f)
+		return false;
+
+	auto t = glm::dot(__position - ray.origin, __orientation) / denom;
+	if (t < t_min || t > t_max)
+		return false;
+
+	auto local_hit = ray.at(t) - __position;
+	return glm::abs(glm::dot(local_hit, __tangent)) <= (__width / 2.0f) &&
+		glm::abs(glm::dot(local_hit, __bitangent)) <= (__height / 2.0f);
 }
 
 glm::vec2 Plane::getTextureCoordinates(const glm::vec3& p) const
@@ -76,20 +123,44 @@ glm::vec2 Plane::getTextureCoordinates(const glm::vec3& p) const
 	// We need to define a local coordinate system (tangent and bitangent vectors) on the plane to map 
 	// the 3D point to a 2D (u, v) pair.
 
-	// Get the plane's normal.
-	auto n = this->__orientation;
-
-	// Calculate a stable orthogonal basis (tangent and bitangent) for the plane.
-	auto tangent = glm::vec3();
-	if (glm::abs(n.x) > glm::abs(n.y))
-		tangent = glm::normalize(glm::vec3(n.z, 0.0f, -n.x));
-	else
-		tangent = glm::normalize(glm::vec3(0.0f, -n.z, n.y));
-	auto bitangent = glm::cross(n, tangent);
-
+	// The tangent and bitangent are computed once in the constructor.
 	// The hit point 'p' is in world space. We need to project it onto the plane's local coordinate system.
 	auto local_hit = p - this->__position;
-	auto u = glm::dot(local_hit, tangent);
-	auto v = glm::dot(local_hit, bitangent);
+	auto u = glm::dot(local_hit, __tangent);
+	auto v = glm::dot(local_hit, __bitangent);
 	return glm::vec2(u, v);
 }
+
+bool Plane::sampleSurface(const glm::vec3& p,
+													const glm::vec2& u,
+													LightSample& sample) const
+{
+	// Uniform sampling of the rectangle. A density of 1 / area per unit of area becomes, per unit of solid angle
+	// seen from p, d^2 / (|cos(theta_l)| * area), where theta_l is the angle between the plane normal and the direction to p.
+	sample.point = __position + ((u.x - 0.5f) * __width) * __tangent + ((u.y - 0.5f) * __height) * __bitangent;
+	sample.normal = __orientation;
+	sample.texture_coordinates = u;		// same mapping as computeSurfaceInteraction
+	sample.pdf = getSurfacePdf(p, sample.point);
+	return sample.pdf > 0.f;
+}
+
+float Plane::getSurfacePdf(const glm::vec3& p,
+													 const glm::vec3& q) const
+{
+	auto to_point = q - p;
+	auto distance2 = glm::length2(to_point);
+	auto cos_theta_l = glm::abs(glm::dot(__orientation, to_point)) / glm::sqrt(distance2);
+	if (cos_theta_l < 1e-6f) // p is in the plane of the rectangle
+		return 0.f;
+	return distance2 / (cos_theta_l * __width * __height);
+}
+
+AABB Plane::getBoundingBox() const
+{
+	// The plane is a finite rectangle spanned by the same tangent and bitangent used for texture mapping.
+	// Its box is the center plus the absolute extent of the two half edges along each axis,
+	// padded by a small amount so that axis-aligned planes do not produce a degenerate slab.
+	auto half_extent = glm::abs(__tangent) * (__width * 0.5f) + glm::abs(__bitangent) * (__height * 0.5f);
+	half_extent = glm::max(half_extent, glm::vec3(1e-4f));
+	return AABB(__position - half_extent, __position + half_extent);
+}
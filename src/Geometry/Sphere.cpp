@@ -1,5 +1,6 @@
 #include "Geometry/Sphere.hpp"
 #include "Ray.hpp"
+#include "Sampler/Sampling.hpp"
 
 #include <cmath>
 #include <glm/gtx/norm.hpp> // glm::length2
@@ -34,8 +35,8 @@ bool Sphere::intersect(const Ray& ray,
   // Coefficients for the quadratic equation: at^2 + bt + c = 0
   auto a = glm::length2(d);
   auto b = 2.f * glm::dot(d, r0p0);
-  auto c = glm::length2(r0p0) - glm::pow(__radius, 2);
-  auto delta = glm::pow(b, 2) - 4.f * a * c;
+  auto c = glm::length2(r0p0) - __radius * __radius;
+  auto delta = b * b - 4.f * a * c;
   if (delta < 1e-6f) // No real roots -> no intersection
     return false;
 
@@ -49,25 +50,58 @@ bool Sphere::intersect(const Ray& ray,
       return false;
   }
 
-  auto hit_point = ray.at(t);
+  hit.t = t;
+  hit.object = this;
+  hit.primitive_id = 0;
+  hit.instance_count = 0;
+	return true;
+}
+
+void Sphere::computeSurfaceInteraction(const Ray& ray,
+                                       HitRecord& hit) const
+{
+  auto hit_point = ray.at(hit.t);
   auto n = this->getNormal(hit_point); // Already normalized
   auto tc = this->getTextureCoordinates(hit_point);
   
   auto is_ray_outside = true;
-  if (glm::dot(d, n) > 0.f) // Ray is inside the sphere
+  if (glm::dot(ray.direction, n) > 0.f) // Ray is inside the sphere
   {
     is_ray_outside = false;
     n = -n;
   }
 
-  hit.t = t;
   hit.tc_u = tc.x;
   hit.tc_v = tc.y;
   hit.point = hit_point;
   hit.normal = n;
   hit.is_ray_outside = is_ray_outside;
-  hit.material = this->__material;
-	return true;
+  hit.material = this->__material.get();
+  hit.material_id = this->__material_id;
+  hit.light_id = this->__light_id;
+}
+
+bool Sphere::occludes(const Ray& ray,
+                      float t_min,
+                      float t_max) const
+{
+  // Same quadratic as intersect, written with the half coefficient b' = b/2 to save a few multiplications:
+  // t = (-b' +- sqrt(b'^2 - a*c)) / a
+  // The segment is blocked if either root falls in [t_min, t_max].
+  auto r0p0 = ray.origin - __position;
+  auto a = glm::length2(ray.direction);
+  auto half_b = glm::dot(ray.direction, r0p0);
+  auto c = glm::length2(r0p0) - __radius * __radius;
+  auto quarter_delta = half_b * half_b - a * c;
+  if (quarter_delta < 0.25e-6f)
+    return false;
+
+  auto sqroot = glm::sqrt(quarter_delta);
+  auto t = (-half_b - sqroot) / a;
+  if (t >= t_min && t <= t_max)
+    return true;
+  t = (-half_b + sqroot) / a;
+  return t >= t_min && t <= t_max;
 }
 
 glm::vec3 Sphere::getNormal(const glm::vec3& p) const 
@@ -98,4 +132,70 @@ glm::vec2 Sphere::getTextureCoordinates(const glm::vec3& p) const
   auto u = (theta + glm::pi<float>()) / (2.0f * glm::pi<float>());
   auto v = phi / glm::pi<float>();
   return glm::vec2(u, v);
-}
\ No newline at end of file
+}
+
+bool Sphere::sampleSurface(const glm::vec3& p,
+                           const glm::vec2& u,
+                           LightSample& sample) const
+{
+  // Seen from p, the sphere covers a cone of directions around the direction of its center,
+  // of half-angle theta_max with sin(theta_max) = r / d. Sampling the directions of this cone uniformly
+  // (instead of the area of the sphere) never picks a point on the hidden side,
+  // and the density is constant: 1 / solid angle = 1 / (2 * pi * (1 - cos(theta_max))).
+  // See Pharr, Jakob and Humphreys, "Physically Based Rendering", 4th edition, 6.2.4.
+  auto one_minus_cos_theta_max = 0.f;
+  auto pdf = __computeConePdf(p, one_minus_cos_theta_max);
+  if (pdf == 0.f)
+    return false;
+
+  auto sin2_theta_max = __radius * __radius / glm::length2(__position - p);
+  auto sin_theta_max = glm::sqrt(sin2_theta_max);
+
+  // Direction in the cone: cos(theta) is uniform in [cos(theta_max), 1]
+  auto cos_theta = 1.f - u.x * one_minus_cos_theta_max;
+  auto sin2_theta = 1.f - cos_theta * cos_theta;
+  if (sin2_theta_max < 0.00068523f) // sin^2(1.5 degrees): the cone is narrow, avoid the cancellation in 1 - cos^2
+  {
+    sin2_theta = sin2_theta_max * u.x;
+    cos_theta = glm::sqrt(1.f - sin2_theta);
+  }
+
+  // Point hit by that direction, given by its angle alpha from the axis, seen from the center of the sphere
+  auto cos_alpha = sin2_theta / sin_theta_max + cos_theta * glm::sqrt(glm::max(0.f, 1.f - sin2_theta / sin2_theta_max));
+  auto sin_alpha = glm::sqrt(glm::max(0.f, 1.f - cos_alpha * cos_alpha));
+  auto phi = 2.f * glm::pi<float>() * u.y;
+
+  // Rotate the point to the frame of the axis
+  auto basis = OrthonormalBasis(glm::normalize(__position - p));
+  auto n = -basis.toWorld(glm::vec3(sin_alpha * std::cos(phi), sin_alpha * std::sin(phi), cos_alpha));
+  sample.point = __position + __radius * n;
+  sample.normal = n;
+  sample.texture_coordinates = getTextureCoordinates(sample.point);
+  sample.pdf = pdf;
+  return true;
+}
+
+float Sphere::getSurfacePdf(const glm::vec3& p,
+                            const glm::vec3& q) const
+{
+  // Every visible point has the same density
+  auto one_minus_cos_theta_max = 0.f;
+  return __computeConePdf(p, one_minus_cos_theta_max);
+}
+
+AABB Sphere::getBoundingBox() const
+{
+  auto r = glm::vec3(__radius);
+  return AABB(__position - r, __position + r);
+}
+
+float Sphere::__computeConePdf(const glm::vec3& p, float& one_minus_cos_theta_max) const
+{
+  auto sin2_theta_max = __radius * __radius / glm::length2(__position - p);
+  if (sin2_theta_max >= 1.f) // p is inside the sphere
+    return 0.f;
+
+  // For a narrow cone, 1 - cos(theta_max) is taken from its Taylor expansion, sin^2 / 2, which does not cancel out
+  one_minus_cos_theta_max = sin2_theta_max < 0.00068523f ? 0.5f * sin2_theta_max : 1.f - glm::sqrt(1.f - sin2_theta_max);
+  return 1.f / (2.f * glm::pi<float>() * one_minus_cos_theta_max);
+}
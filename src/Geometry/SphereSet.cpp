@@ -0,0 +1,286 @@
+#include "Geometry/SphereSet.hpp"
+#include "Ray.hpp"
+#include "Simd.hpp"
+
+#include <cassert>
+#include <limits>
+#include <glm/gtc/constants.hpp>
+
+namespace
+{
+	using namespace simd;
+
+	constexpr auto max_leaf_size = 8u;	// independent of the SIMD width, so that every build produces the same tree
+
+	struct SphereArrays
+	{
+		const float* x;
+		const float* y;
+		const float* z;
+		const float* radius;
+	};
+
+	/**
+	 * @brief Distances along the ray to the first sphere surface in [t_min, t_max], for simd_width spheres.
+	 * With a normalized direction d and oc = center - origin, the quadratic of Sphere::intersect simplifies to
+	 * t = b -+ sqrt(b^2 - c), where b = d.oc and c = oc.oc - r^2.
+	 * Lanes past count, or whose sphere is missed, are cleared in the returned mask.
+	 */
+	inline MaskN intersectSpheres(const SphereArrays& spheres,
+																uint32_t index,
+																const FloatN origin[3],
+																const FloatN direction[3],
+																FloatN lane,
+																FloatN count,
+																FloatN t_min,
+																FloatN t_max,
+																FloatN& t)
+	{
+		const auto zero = broadcast(0.f);
+		auto ocx = sub(load(spheres.x + index), origin[0]);
+		auto ocy = sub(load(spheres.y + index), origin[1]);
+		auto ocz = sub(load(spheres.z + index), origin[2]);
+		auto radius = load(spheres.radius + index);
+
+		auto b = add(add(mul(ocx, direction[0]), mul(ocy, direction[1])), mul(ocz, direction[2]));
+		auto c = sub(add(add(mul(ocx, ocx), mul(ocy, ocy)), mul(ocz, ocz)), mul(radius, radius));
+		auto discriminant = sub(mul(b, b), c);
+		auto valid = logicalAnd(greaterEqual(discriminant, zero), lessThan(lane, count));
+
+		// Take the nearest root, or the farthest one if the nearest is behind t_min (the origin is inside the sphere)
+		auto root = sqrt(max(discriminant, zero));
+		auto t_near = sub(b, root);
+		t = select(greaterEqual(t_near, t_min), t_near, add(b, root));
+		return logicalAnd(valid, logicalAnd(greaterEqual(t, t_min), lessEqual(t, t_max)));
+	}
+
+	/** @brief Closest hit among the spheres of a leaf. On a hit, t_max is reduced and closest_slot is set */
+	bool intersectLeaf(const SphereArrays& spheres,
+										 const Ray& ray,
+										 uint32_t first,
+										 uint32_t count,
+										 float t_min,
+										 float& t_max,
+										 uint32_t& closest_slot)
+	{
+		const FloatN origin[3] = { broadcast(ray.origin.x), broadcast(ray.origin.y), broadcast(ray.origin.z) };
+		const FloatN direction[3] = { broadcast(ray.direction.x), broadcast(ray.direction.y), broadcast(ray.direction.z) };
+		const auto t_min_n = broadcast(t_min);
+		const auto count_n = broadcast(static_cast<float>(count));
+
+		// Keep the best distance of each lane, and reduce across the lanes only once at the end
+		auto best_t = broadcast(t_max);
+		auto best_lane = broadcast(-1.f);
+		for (auto i = 0u; i < count; i += simd_width)
+		{
+			auto lane = add(laneOffsets(), broadcast(static_cast<float>(i)));
+			auto t = broadcast(0.f);
+			auto hit = intersectSpheres(spheres, first + i, origin, direction, lane, count_n, t_min_n, best_t, t);
+			best_t = select(hit, t, best_t);
+			best_lane = select(hit, lane, best_lane);
+		}
+
+		float lane_t[simd_width];
+		float lane_index[simd_width];
+		store(lane_t, best_t);
+		store(lane_index, best_lane);
+		auto hit = false;
+		for (auto i = 0u; i < simd_width; ++i)
+		{
+			if (lane_index[i] >= 0.f && lane_t[i] <= t_max)
+			{
+				t_max = lane_t[i];
+				closest_slot = first + static_cast<uint32_t>(lane_index[i]);
+				hit = true;
+			}
+		}
+		return hit;
+	}
+
+	bool occludesLeaf(const SphereArrays& spheres,
+										const Ray& ray,
+										uint32_t first,
+										uint32_t count,
+										float t_min,
+										float t_max)
+	{
+		const FloatN origin[3] = { broadcast(ray.origin.x), broadcast(ray.origin.y), broadcast(ray.origin.z) };
+		const FloatN direction[3] = { broadcast(ray.direction.x), broadcast(ray.direction.y), broadcast(ray.direction.z) };
+		const auto t_min_n = broadcast(t_min);
+		const auto t_max_n = broadcast(t_max);
+		const auto count_n = broadcast(static_cast<float>(count));
+		for (auto i = 0u; i < count; i += simd_width)
+		{
+			auto lane = add(laneOffsets(), broadcast(static_cast<float>(i)));
+			auto t = broadcast(0.f);
+			if (any(intersectSpheres(spheres, first + i, origin, direction, lane, count_n, t_min_n, t_max_n, t)))
+				return true;
+		}
+		return false;
+	}
+}
+
+/**
+ * ============================================
+ *		PUBLIC
+ * ============================================
+ */
+
+SphereSet::SphereSet(const std::vector<glm::vec3>& centers,
+										 const std::vector<float>& radii,
+										 const std::shared_ptr<IMaterial>& material) :
+	IHittableObject(glm::vec3(0.f), material)
+{
+	assert(!centers.empty() && centers.size() == radii.size());
+
+	auto bounds = std::vector<AABB>(centers.size());
+	for (auto i = 0u; i < centers.size(); ++i)
+		bounds[i] = AABB(centers[i] - radii[i], centers[i] + radii[i]);
+	__bvh.build(bounds, max_leaf_size);
+
+	// Lay out the spheres in leaf order. The padding lets the kernel load full SIMD registers at the end of the last leaf.
+	auto sphere_indices = __bvh.getPrimitiveIndices();
+	auto padded_size = sphere_indices.size() + max_leaf_size;
+	__center_x.resize(padded_size, 0.f);
+	__center_y.resize(padded_size, 0.f);
+	__center_z.resize(padded_size, 0.f);
+	__radius.resize(padded_size, 0.f);
+	for (auto slot = 0u; slot < sphere_indices.size(); ++slot)
+	{
+		auto index = sphere_indices[slot];
+		__center_x[slot] = centers[index].x;
+		__center_y[slot] = centers[index].y;
+		__center_z[slot] = centers[index].z;
+		__radius[slot] = radii[index];
+	}
+	__position = __bvh.getBounds().getCentroid();
+}
+
+uint32_t SphereSet::getSimdWidth()
+{
+	return simd_width;
+}
+
+bool SphereSet::intersectClosest(const Ray& ray,
+																 float t_min,
+																 float t_max,
+																 uint32_t& sphere_index,
+																 float& t) const
+{
+	// The kernel relies on a normalized direction, which Ray guarantees
+	auto spheres = SphereArrays{ __center_x.data(), __center_y.data(), __center_z.data(), __radius.data() };
+	auto closest_slot = 0u;
+	auto hit = __bvh.intersectLeaves(ray, t_min, t_max, [&](uint32_t first, uint32_t count, float t_near, float& t_far) -> bool {
+		return intersectLeaf(spheres, ray, first, count, t_near, t_far, closest_slot);
+	});
+	if (!hit)
+		return false;
+
+	sphere_index = __bvh.getPrimitiveIndices()[closest_slot];
+	t = t_max;
+	return true;
+}
+
+bool SphereSet::intersect(const Ray& ray,
+													float t_min,
+													float t_max,
+													HitRecord& hit) const
+{
+	auto spheres = SphereArrays{ __center_x.data(), __center_y.data(), __center_z.data(), __radius.data() };
+	auto closest_slot = 0u;
+	auto closest_t = t_max;
+	auto found = __bvh.intersectLeaves(ray, t_min, closest_t, [&](uint32_t first, uint32_t count, float t_near, float& t_far) -> bool {
+		return intersectLeaf(spheres, ray, first, count, t_near, t_far, closest_slot);
+	});
+	if (!found)
+		return false;
+
+	hit.t = closest_t;
+	hit.object = this;
+	hit.primitive_id = closest_slot;	// the slot rather than the input index, it addresses the arrays directly
+	hit.instance_count = 0;
+	return true;
+}
+
+void SphereSet::computeSurfaceInteraction(const Ray& ray,
+																					HitRecord& hit) const
+{
+	auto slot = hit.primitive_id;
+	auto center = glm::vec3(__center_x[slot], __center_y[slot], __center_z[slot]);
+	auto hit_point = ray.at(hit.t);
+	auto n = (hit_point - center) / __radius[slot];
+	auto tc = __computeTextureCoordinates(slot, hit_point);
+
+	auto is_ray_outside = true;
+	if (glm::dot(ray.direction, n) > 0.f) // Ray is inside the sphere
+	{
+		is_ray_outside = false;
+		n = -n;
+	}
+
+	hit.tc_u = tc.x;
+	hit.tc_v = tc.y;
+	hit.point = hit_point;
+	hit.normal = n;
+	hit.is_ray_outside = is_ray_outside;
+	hit.material = this->__material.get();
+	hit.material_id = this->__material_id;
+	hit.light_id = this->__light_id;
+}
+
+bool SphereSet::occludes(const Ray& ray,
+												 float t_min,
+												 float t_max) const
+{
+	auto spheres = SphereArrays{ __center_x.data(), __center_y.data(), __center_z.data(), __radius.data() };
+	return __bvh.occludedLeaves(ray, t_min, t_max, [&](uint32_t first, uint32_t count, float t_near, float t_far) -> bool {
+		return occludesLeaf(spheres, ray, first, count, t_near, t_far);
+	});
+}
+
+glm::vec3 SphereSet::getNormal(const glm::vec3& p) const
+{
+	auto slot = __findClosestSlot(p);
+	auto center = glm::vec3(__center_x[slot], __center_y[slot], __center_z[slot]);
+	return glm::normalize(p - center);
+}
+
+glm::vec2 SphereSet::getTextureCoordinates(const glm::vec3& p) const
+{
+	return __computeTextureCoordinates(__findClosestSlot(p), p);
+}
+
+/**
+ * ============================================
+ *		PRIVATE
+ * ============================================
+ */
+
+uint32_t SphereSet::__findClosestSlot(const glm::vec3& p) const
+{
+	auto closest_slot = 0u;
+	auto closest_distance = std::numeric_limits<float>::infinity();
+	for (auto slot = 0u; slot < getSphereCount(); ++slot)
+	{
+		auto center = glm::vec3(__center_x[slot], __center_y[slot], __center_z[slot]);
+		auto distance = glm::abs(glm::length(p - center) - __radius[slot]);
+		if (distance < closest_distance)
+		{
+			closest_distance = distance;
+			closest_slot = slot;
+		}
+	}
+	return closest_slot;
+}
+
+glm::vec2 SphereSet::__computeTextureCoordinates(uint32_t slot, const glm::vec3& p) const
+{
+	// Spherical projection, as in Sphere::getTextureCoordinates
+	auto center = glm::vec3(__center_x[slot], __center_y[slot], __center_z[slot]);
+	auto local_p = (p - center) / __radius[slot];
+	auto theta = std::atan2(local_p.z, local_p.x);
+	auto phi = glm::acos(glm::clamp(-local_p.y, -1.f, 1.f));
+	auto u = (theta + glm::pi<float>()) / (2.0f * glm::pi<float>());
+	auto v = phi / glm::pi<float>();
+	return glm::vec2(u, v);
+}
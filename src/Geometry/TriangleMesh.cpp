@@ -0,0 +1,390 @@
+#include "Geometry/TriangleMesh.hpp"
+#include "Ray.hpp"
+
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+#include <glm/gtx/norm.hpp> // glm::length2
+
+namespace
+{
+	/**
+	 * @brief
+	 * Per-ray setup of the watertight test.
+	 * The axis where the direction is largest becomes z, and the other two are chosen to preserve the winding.
+	 * The shear (sx, sy, sz) aligns the direction with +z and scales it to unit length along it.
+	 */
+	struct WatertightRay
+	{
+		WatertightRay(const Ray& ray) :
+			origin{ ray.origin }
+		{
+			auto abs_direction = glm::abs(ray.direction);
+			kz = abs_direction.x > abs_direction.y ? (abs_direction.x > abs_direction.z ? 0 : 2) : (abs_direction.y > abs_direction.z ? 1 : 2);
+			kx = (kz + 1) % 3;
+			ky = (kx + 1) % 3;
+			if (ray.direction[kz] < 0.f)
+				std::swap(kx, ky);
+
+			sx = ray.direction[kx] / ray.direction[kz];
+			sy = ray.direction[ky] / ray.direction[kz];
+			sz = 1.f / ray.direction[kz];
+		}
+
+		/** @brief On a hit in [t_min, t_max], return the distance and the barycentric weights of the three vertices */
+		bool intersect(const glm::vec3& v0,
+									 const glm::vec3& v1,
+									 const glm::vec3& v2,
+									 float t_min,
+									 float t_max,
+									 float& t,
+									 glm::vec3& barycentric) const
+		{
+			// Vertices relative to the ray origin, sheared in the ray space
+			auto a = v0 - origin;
+			auto b = v1 - origin;
+			auto c = v2 - origin;
+			auto ax = a[kx] - sx * a[kz];
+			auto ay = a[ky] - sy * a[kz];
+			auto bx = b[kx] - sx * b[kz];
+			auto by = b[ky] - sy * b[kz];
+			auto cx = c[kx] - sx * c[kz];
+			auto cy = c[ky] - sy * c[kz];
+
+			// Scaled barycentric coordinates: the 2D edge functions of the projected triangle
+			auto u = cx * by - cy * bx;
+			auto v = ax * cy - ay * cx;
+			auto w = bx * ay - by * ax;
+
+			// On an edge the float result is unreliable, so the edge functions are evaluated again in double precision
+			if (u == 0.f || v == 0.f || w == 0.f)
+			{
+				u = static_cast<float>(static_cast<double>(cx) * by - static_cast<double>(cy) * bx);
+				v = static_cast<float>(static_cast<double>(ax) * cy - static_cast<double>(ay) * cx);
+				w = static_cast<float>(static_cast<double>(bx) * ay - static_cast<double>(by) * ax);
+			}
+
+			// The ray misses if the edge functions have different signs (both windings are accepted)
+			if ((u < 0.f || v < 0.f || w < 0.f) && (u > 0.f || v > 0.f || w > 0.f))
+				return false;
+
+			auto det = u + v + w;
+			if (det == 0.f)
+				return false;
+
+			// Interpolate the z of the sheared vertices to get the scaled hit distance,
+			// and test the range before the division.
+			auto az = sz * a[kz];
+			auto bz = sz * b[kz];
+			auto cz = sz * c[kz];
+			auto scaled_t = u * az + v * bz + w * cz;
+			if (det < 0.f ? (scaled_t > t_min * det || scaled_t < t_max * det) : (scaled_t < t_min * det || scaled_t > t_max * det))
+				return false;
+
+			auto inv_det = 1.f / det;
+			t = scaled_t * inv_det;
+			barycentric = glm::vec3(u, v, w) * inv_det;
+			return true;
+		}
+
+		glm::vec3 origin;
+		int kx, ky, kz;
+		float sx, sy, sz;
+	};
+
+	/**
+	 * @brief Closest point to p on the triangle (a, b, c), as barycentric weights.
+	 * The point is located in the Voronoi regions of the vertices and edges first, and falls inside the face
+	 * otherwise (C. Ericson, "Real-Time Collision Detection", 5.1.5).
+	 */
+	glm::vec3 closestPointOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+	{
+		auto ab = b - a;
+		auto ac = c - a;
+		auto ap = p - a;
+		auto d1 = glm::dot(ab, ap);
+		auto d2 = glm::dot(ac, ap);
+		if (d1 <= 0.f && d2 <= 0.f)
+			return glm::vec3(1.f, 0.f, 0.f);
+
+		auto bp = p - b;
+		auto d3 = glm::dot(ab, bp);
+		auto d4 = glm::dot(ac, bp);
+		if (d3 >= 0.f && d4 <= d3)
+			return glm::vec3(0.f, 1.f, 0.f);
+
+		auto vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f)
+		{
+			auto v = d1 / (d1 - d3);
+			return glm::vec3(1.f - v, v, 0.f);
+		}
+
+		auto cp = p - c;
+		auto d5 = glm::dot(ab, cp);
+		auto d6 = glm::dot(ac, cp);
+		if (d6 >= 0.f && d5 <= d6)
+			return glm::vec3(0.f, 0.f, 1.f);
+
+		auto vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f)
+		{
+			auto w = d2 / (d2 - d6);
+			return glm::vec3(1.f - w, 0.f, w);
+		}
+
+		auto va = d3 * d6 - d5 * d4;
+		if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f)
+		{
+			auto w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+			return glm::vec3(0.f, 1.f - w, w);
+		}
+
+		auto denom = 1.f / (va + vb + vc);
+		auto v = vb * denom;
+		auto w = vc * denom;
+		return glm::vec3(1.f - v - w, v, w);
+	}
+
+	float distance2(const AABB& box, const glm::vec3& p)
+	{
+		return glm::length2(p - glm::clamp(p, box.min, box.max));
+	}
+}
+
+/**
+ * ============================================
+ *		PUBLIC
+ * ============================================
+ */
+
+std::shared_ptr<MeshData> createMeshData(MeshBuffers&& buffers)
+{
+	auto storage = std::make_shared<MeshBuffers>(std::move(buffers));
+	auto triangle_bounds = std::vector<AABB>();
+	triangle_bounds.reserve(storage->triangles.size());
+	for (const auto& triangle : storage->triangles)
+	{
+		auto bounds = AABB();
+		bounds.expand(storage->positions[triangle.x]);
+		bounds.expand(storage->positions[triangle.y]);
+		bounds.expand(storage->positions[triangle.z]);
+		triangle_bounds.push_back(bounds);
+	}
+
+	auto mesh_data = std::make_shared<MeshData>();
+	mesh_data->positions = storage->positions;
+	mesh_data->normals = storage->normals;
+	mesh_data->texture_coordinates = storage->texture_coordinates;
+	mesh_data->triangles = storage->triangles;
+	mesh_data->bvh.build(triangle_bounds);
+	mesh_data->storage = std::move(storage);
+	return mesh_data;
+}
+
+TriangleMesh::TriangleMesh(std::shared_ptr<const MeshData> mesh_data,
+													 const std::shared_ptr<IMaterial>& material) :
+	IHittableObject(glm::vec3(0.f), material),
+	__mesh_data{ std::move(mesh_data) }
+{
+	assert(__mesh_data);
+	// Without triangles the mesh has no bounds and no surface to query
+	if (__mesh_data->triangles.empty())
+		throw std::invalid_argument("TriangleMesh: the mesh has no triangles");
+	assert(__mesh_data->bvh.isBuilt());
+	assert(__mesh_data->normals.empty() || __mesh_data->normals.size() == __mesh_data->positions.size());
+	assert(__mesh_data->texture_coordinates.empty() || __mesh_data->texture_coordinates.size() == __mesh_data->positions.size());
+
+	__bvh = __mesh_data->bvh;
+	__position = __bvh.getBounds().getCentroid();
+}
+
+bool TriangleMesh::intersect(const Ray& ray,
+														 float t_min,
+														 float t_max,
+														 HitRecord& hit) const
+{
+	const auto& positions = __mesh_data->positions;
+	const auto& triangles = __mesh_data->triangles;
+	const auto& triangle_indices = __bvh.getPrimitiveIndices();
+	auto watertight_ray = WatertightRay(ray);
+
+	auto closest_triangle = std::numeric_limits<uint32_t>::max();
+	auto closest_t = t_max;
+	auto closest_barycentric = glm::vec3(0.f);
+	__bvh.intersect(ray, t_min, closest_t, [&](uint32_t slot, float t_near, float& t_far) -> bool {
+		auto index = triangle_indices[slot];
+		const auto& triangle = triangles[index];
+		auto t = 0.f;
+		auto barycentric = glm::vec3(0.f);
+		if (!watertight_ray.intersect(positions[triangle.x], positions[triangle.y], positions[triangle.z], t_near, t_far, t, barycentric))
+			return false;
+		t_far = t;
+		closest_triangle = index;
+		closest_barycentric = barycentric;
+		return true;
+	});
+	if (closest_triangle == std::numeric_limits<uint32_t>::max())
+		return false;
+
+	// Only two barycentric coordinates are kept, the third one is their complement
+	hit.t = closest_t;
+	hit.object = this;
+	hit.primitive_id = closest_triangle;
+	hit.primitive_uv = glm::vec2(closest_barycentric.y, closest_barycentric.z);
+	hit.instance_count = 0;
+	return true;
+}
+
+void TriangleMesh::computeSurfaceInteraction(const Ray& ray,
+																						 HitRecord& hit) const
+{
+	auto triangle = hit.primitive_id;
+	auto barycentric = glm::vec3(1.f - hit.primitive_uv.x - hit.primitive_uv.y, hit.primitive_uv.x, hit.primitive_uv.y);
+
+	// The side of the surface is given by the geometric normal, the interpolated one is only used for shading
+	auto geometric_normal = __computeGeometricNormal(triangle);
+	auto n = __interpolateNormal(triangle, barycentric);
+	auto tc = __interpolateTextureCoordinates(triangle, barycentric);
+
+	auto is_ray_outside = true;
+	if (glm::dot(ray.direction, geometric_normal) > 0.f) // Ray hits the back face
+	{
+		is_ray_outside = false;
+		n = -n;
+	}
+
+	hit.tc_u = tc.x;
+	hit.tc_v = tc.y;
+	hit.point = ray.at(hit.t);
+	hit.normal = n;
+	hit.is_ray_outside = is_ray_outside;
+	hit.material = this->__material.get();
+	hit.material_id = this->__material_id;
+	hit.light_id = this->__light_id;
+}
+
+bool TriangleMesh::occludes(const Ray& ray,
+														float t_min,
+														float t_max) const
+{
+	const auto& positions = __mesh_data->positions;
+	const auto& triangles = __mesh_data->triangles;
+	const auto& triangle_indices = __bvh.getPrimitiveIndices();
+	auto watertight_ray = WatertightRay(ray);
+
+	return __bvh.occluded(ray, t_min, t_max, [&](uint32_t slot, float t_near, float t_far) -> bool {
+		const auto& triangle = triangles[triangle_indices[slot]];
+		auto t = 0.f;
+		auto barycentric = glm::vec3(0.f);
+		return watertight_ray.intersect(positions[triangle.x], positions[triangle.y], positions[triangle.z], t_near, t_far, t, barycentric);
+	});
+}
+
+glm::vec3 TriangleMesh::getNormal(const glm::vec3& p) const
+{
+	auto barycentric = glm::vec3(0.f);
+	auto triangle = __findClosestTriangle(p, barycentric);
+	return __interpolateNormal(triangle, barycentric);
+}
+
+glm::vec2 TriangleMesh::getTextureCoordinates(const glm::vec3& p) const
+{
+	auto barycentric = glm::vec3(0.f);
+	auto triangle = __findClosestTriangle(p, barycentric);
+	return __interpolateTextureCoordinates(triangle, barycentric);
+}
+
+/**
+ * ============================================
+ *		PRIVATE
+ * ============================================
+ */
+
+uint32_t TriangleMesh::__findClosestTriangle(const glm::vec3& p, glm::vec3& barycentric) const
+{
+	// Depth-first search of the BVH, visiting the nearest child first and skipping
+	// the nodes whose box is farther than the closest triangle found so far.
+	const auto& positions = __mesh_data->positions;
+	const auto& triangles = __mesh_data->triangles;
+	const auto& nodes = __bvh.getNodes();
+	const auto& triangle_indices = __bvh.getPrimitiveIndices();
+
+	auto closest_triangle = 0u;
+	auto closest_distance2 = std::numeric_limits<float>::infinity();
+	uint32_t stack[BVH::TRAVERSAL_STACK_SIZE];
+	auto stack_size = 0u;
+	if (!nodes.empty())
+		stack[stack_size++] = 0u;
+
+	while (stack_size > 0)
+	{
+		const auto& node = nodes[stack[--stack_size]];
+		if (distance2(node.bounds, p) >= closest_distance2)
+			continue;
+
+		if (node.isLeaf())
+		{
+			for (auto i = 0u; i < node.primitive_count; ++i)
+			{
+				auto index = triangle_indices[node.offset + i];
+				const auto& triangle = triangles[index];
+				const auto& a = positions[triangle.x];
+				const auto& b = positions[triangle.y];
+				const auto& c = positions[triangle.z];
+				auto weights = closestPointOnTriangle(p, a, b, c);
+				auto d2 = glm::length2(p - (weights.x * a + weights.y * b + weights.z * c));
+				if (d2 < closest_distance2)
+				{
+					closest_distance2 = d2;
+					closest_triangle = index;
+					barycentric = weights;
+				}
+			}
+		}
+		else
+		{
+			auto first = node.offset;
+			auto second = node.offset + 1;
+			if (distance2(nodes[first].bounds, p) < distance2(nodes[second].bounds, p))
+				std::swap(first, second);
+			stack[stack_size++] = first;
+			stack[stack_size++] = second;
+		}
+	}
+	return closest_triangle;
+}
+
+glm::vec3 TriangleMesh::__computeGeometricNormal(uint32_t triangle) const
+{
+	const auto& positions = __mesh_data->positions;
+	const auto& vertices = __mesh_data->triangles[triangle];
+	auto e1 = positions[vertices.y] - positions[vertices.x];
+	auto e2 = positions[vertices.z] - positions[vertices.x];
+	return glm::normalize(glm::cross(e1, e2));
+}
+
+glm::vec3 TriangleMesh::__interpolateNormal(uint32_t triangle, const glm::vec3& barycentric) const
+{
+	const auto& normals = __mesh_data->normals;
+	if (normals.empty())
+		return __computeGeometricNormal(triangle);
+
+	const auto& vertices = __mesh_data->triangles[triangle];
+	auto n = barycentric.x * normals[vertices.x] + barycentric.y * normals[vertices.y] + barycentric.z * normals[vertices.z];
+	auto length2 = glm::length2(n);
+	return length2 > 0.f ? n / glm::sqrt(length2) : __computeGeometricNormal(triangle);
+}
+
+glm::vec2 TriangleMesh::__interpolateTextureCoordinates(uint32_t triangle, const glm::vec3& barycentric) const
+{
+	// Without texture coordinates, use the barycentric coordinates of the triangle
+	const auto& texture_coordinates = __mesh_data->texture_coordinates;
+	if (texture_coordinates.empty())
+		return glm::vec2(barycentric.y, barycentric.z);
+
+	const auto& vertices = __mesh_data->triangles[triangle];
+	return barycentric.x * texture_coordinates[vertices.x] +
+		barycentric.y * texture_coordinates[vertices.y] +
+		barycentric.z * texture_coordinates[vertices.z];
+}
@@ -0,0 +1,105 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::filesystem::path& file_path)
+{
+	close();
+
+	auto file_handle = CreateFileW(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file_handle == INVALID_HANDLE_VALUE)
+		return false;
+
+	auto file_size = LARGE_INTEGER{};
+	if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0)
+	{
+		CloseHandle(file_handle);
+		return false;
+	}
+
+	auto mapping_handle = CreateFileMappingW(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping_handle == nullptr)
+	{
+		CloseHandle(file_handle);
+		return false;
+	}
+
+	auto data = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr)
+	{
+		CloseHandle(mapping_handle);
+		CloseHandle(file_handle);
+		return false;
+	}
+
+	__file_handle = file_handle;
+	__mapping_handle = mapping_handle;
+	__data = static_cast<const std::byte*>(data);
+	__size = static_cast<size_t>(file_size.QuadPart);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (__data)
+		UnmapViewOfFile(__data);
+	if (__mapping_handle)
+		CloseHandle(__mapping_handle);
+	if (__file_handle)
+		CloseHandle(__file_handle);
+	__data = nullptr;
+	__size = 0;
+	__file_handle = nullptr;
+	__mapping_handle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::filesystem::path& file_path)
+{
+	close();
+
+	auto file_descriptor = ::open(file_path.c_str(), O_RDONLY);
+	if (file_descriptor < 0)
+		return false;
+
+	struct stat file_status;
+	if (fstat(file_descriptor, &file_status) != 0 || file_status.st_size == 0)
+	{
+		::close(file_descriptor);
+		return false;
+	}
+
+	auto size = static_cast<size_t>(file_status.st_size);
+	auto data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+	// The mapping keeps its own reference to the file
+	::close(file_descriptor);
+	if (data == MAP_FAILED)
+		return false;
+
+	__data = static_cast<const std::byte*>(data);
+	__size = size;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (__data)
+		munmap(const_cast<std::byte*>(__data), __size);
+	__data = nullptr;
+	__size = 0;
+}
+
+#endif
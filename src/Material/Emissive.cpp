@@ -1,9 +1,9 @@
 #include "Material/Emissive.hpp"
 
-glm::vec3 Emissive::emitted(float u, float v) const
+glm::vec3 Emissive::emitted(const MaterialRecord& material, float u, float v)
 {
-  if (emission_texture != nullptr)
-    return emission_scale * emission_texture->sample(u, v);
+  if (material.emission_texture != nullptr)
+    return material.emission_scale * material.emission_texture->sample(u, v);
 
-  return emission_scale;
+  return material.emission_scale;
 }
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "Material/MaterialTable.hpp"
+#include "Material/Matte.hpp"
+#include "Material/Metal.hpp"
+#include "Material/Emissive.hpp"
+#include "Geometry/IHittableObject.hpp"
+
+#include <algorithm>
+
+/**
+ * ============================================
+ *		PUBLIC
+ * ============================================
+ */
+
+void MaterialTable::add(const std::vector<const IMaterial*>& materials)
+{
+	for (auto material : materials)
+	{
+		if (!__ids.try_emplace(material, static_cast<uint32_t>(__records.size())).second)
+			continue;
+		__records.push_back(material->getRecord());
+		__materials.push_back(material);
+	}
+}
+
+void MaterialTable::clear()
+{
+	__records.clear();
+	__materials.clear();
+	__ids.clear();
+}
+
+void MaterialTable::build()
+{
+	// Stable, so that materials of the same type keep the order in which they were added
+	std::stable_sort(__materials.begin(), __materials.end(), [](const IMaterial* a, const IMaterial* b) {
+		return a->getType() < b->getType();
+	});
+
+	__records.clear();
+	for (auto id = 0u; id < __materials.size(); ++id)
+	{
+		__records.push_back(__materials[id]->getRecord());
+		__ids[__materials[id]] = id;
+	}
+}
+
+bool MaterialTable::scatter(uint32_t material_id,
+														const Ray& incident,
+														const HitRecord& hit,
+														const glm::vec2& u,
+														glm::vec3& surface_color,
+														Ray& scattered_ray) const
+{
+	if (material_id == NO_MATERIAL)
+		return false;
+
+	const auto& material = __records[material_id];
+	switch (material.type)
+	{
+	case MaterialType::MATTE:	return Matte::scatter(material, incident, hit, u, surface_color, scattered_ray);
+	case MaterialType::METAL:	return Metal::scatter(material, incident, hit, u, surface_color, scattered_ray);
+	default:									return false;	// emissive materials do not scatter
+	}
+}
+
+glm::vec3 MaterialTable::emitted(uint32_t material_id, float u, float v) const
+{
+	if (material_id == NO_MATERIAL)
+		return glm::vec3(0.f);
+
+	const auto& material = __records[material_id];
+	switch (material.type)
+	{
+	case MaterialType::EMISSIVE:	return Emissive::emitted(material, u, v);
+	default:											return glm::vec3(0.f);
+	}
+}
+
+glm::vec3 MaterialTable::evaluate(uint32_t material_id, const HitRecord& hit, const glm::vec3& outgoing, const glm::vec3& direction) const
+{
+	if (material_id == NO_MATERIAL)
+		return glm::vec3(0.f);
+
+	const auto& material = __records[material_id];
+	switch (material.type)
+	{
+	case MaterialType::MATTE:	return Matte::evaluate(material, hit, direction);
+	case MaterialType::METAL:	return Metal::evaluate(material, hit, outgoing, direction);
+	default:									return glm::vec3(0.f);
+	}
+}
+
+float MaterialTable::pdf(uint32_t material_id, const HitRecord& hit, const glm::vec3& outgoing, const glm::vec3& direction) const
+{
+	if (material_id == NO_MATERIAL)
+		return 0.f;
+
+	const auto& material = __records[material_id];
+	switch (material.type)
+	{
+	case MaterialType::MATTE:	return Matte::pdf(hit, direction);
+	case MaterialType::METAL:	return Metal::pdf(material, hit, outgoing, direction);
+	default:									return 0.f;
+	}
+}
+
+glm::vec3 MaterialTable::albedo(uint32_t material_id, const HitRecord& hit) const
+{
+	if (material_id == NO_MATERIAL)
+		return glm::vec3(0.f);
+
+	const auto& material = __records[material_id];
+	switch (material.type)
+	{
+	case MaterialType::MATTE:
+	case MaterialType::METAL:
+		if (material.color_texture != nullptr)
+			return material.color_scale * material.color_texture->sample(hit.tc_u, hit.tc_v);
+		return material.color_scale;
+	default:
+		return glm::vec3(1.f);
+	}
+}
@@ -2,9 +2,19 @@
 #include "Geometry/IHittableObject.hpp"
 
 #include "Ray.hpp"
+#include "Sampler/Sampling.hpp"
 
-#include <glm/gtx/norm.hpp>		// glm::length2
-#include <glm/gtc/random.hpp> // glm::sphericalRand
+namespace
+{
+  // If a texture is provided, it samples the texture at the hit point's UV coordinates and 
+  // multiplies it by the base color scale.
+  glm::vec3 getAlbedo(const MaterialRecord& material, const HitRecord& hit)
+  {
+    if (material.color_texture != nullptr)
+      return material.color_scale * material.color_texture->sample(hit.tc_u, hit.tc_v);
+    return material.color_scale;
+  }
+}
 
 /**
  * We'll start with diffuse materials (also called matte).
@@ -23,32 +33,42 @@
  * This non-uniform Lambertian distribution does a better job of modeling material reflection in the real world 
  * than our previous uniform scattering.
  * 
- * We can create this distribution by adding a random unit vector to the normal vector. At the point of intersection 
- * on a surface there is the hit point, p, and there is the normal of the surface, n.
+ * We can create this distribution by adding a random unit vector to the normal vector, but the sum has to be
+ * normalized, and it vanishes when the random vector is opposite to the normal.
+ * Instead, the direction is drawn directly in the frame of the normal n at the hit point p: a uniform point of the
+ * unit disk, lifted to the hemisphere, has exactly density cos(theta) / pi (Malley's method, see Sampling.hpp).
  */
 
-bool Matte::scatter(const Ray& incident,
+bool Matte::scatter(const MaterialRecord& material,
+										const Ray& incident,
 										const HitRecord& hit,
+										const glm::vec2& u,
 										glm::vec3& surface_color,
-										Ray& scattered_ray) const
+										Ray& scattered_ray)
 {
-  // We generate a new direction by adding the surface normal to a random unit vector.
-  auto random_dir = glm::normalize(glm::sphericalRand(1.0f));
-  auto scatter_dir = hit.normal + glm::normalize(random_dir);
+  // Cosine-weighted direction around the surface normal
+  auto basis = OrthonormalBasis(hit.normal);
+  scattered_ray = Ray(hit.point, basis.toWorld(sampleCosineHemisphere(u)));
 
-  // If the random unit vector we generate is exactly opposite the normal vector, 
-  // the two will sum to zero, which will result in a zero scatter direction vector. 
-  // This leads to bad scenarios later on (infinities and NaNs)
-  if (glm::length2(scatter_dir) < 1e-6f)
-    scatter_dir = hit.normal;
+  surface_color = getAlbedo(material, hit);
+  return true;
+}
 
-  scattered_ray = Ray(hit.point, glm::normalize(scatter_dir));
+/**
+ * The directions above are distributed with density cos(theta) / pi, and the Lambertian BSDF is albedo / pi,
+ * so a scattered ray carries f * cos / pdf = albedo: that is the surface color returned by scatter.
+ * Light sampling picks the direction itself, and needs f * cos and the pdf separately.
+ */
 
-  // If a texture is provided, it samples the texture at the hit point's UV coordinates and 
-  // multiplies it by the base color scale.
-  surface_color = color_scale;
-  if (color_texture != nullptr)
-    surface_color = color_scale * color_texture->sample(hit.tc_u, hit.tc_v);
+glm::vec3 Matte::evaluate(const MaterialRecord& material,
+                          const HitRecord& hit,
+                          const glm::vec3& direction)
+{
+  return getAlbedo(material, hit) * pdf(hit, direction);
+}
 
-  return true;
+float Matte::pdf(const HitRecord& hit,
+                 const glm::vec3& direction)
+{
+  return cosineHemispherePdf(glm::dot(hit.normal, direction));
 }
@@ -2,9 +2,28 @@
 #include "Geometry/IHittableObject.hpp"
 
 #include "Ray.hpp"
+#include "Sampler/Sampling.hpp"
 
-#include <glm/gtx/norm.hpp>		// glm::length2
-#include <glm/gtc/random.hpp> // glm::sphericalRand
+namespace
+{
+	/** @brief Roughness at the hit: the scale, times the red channel of the roughness texture if there is one */
+	float getRoughness(const MaterialRecord& material, const HitRecord& hit)
+	{
+		auto roughness = material.roughness_scale;
+		if (material.roughness_texture != nullptr)
+			roughness *= material.roughness_texture->sample(hit.tc_u, hit.tc_v).r;
+		return roughness;
+	}
+
+	/** @brief Schlick's Fresnel: the surface color at normal incidence, blended towards white as cos_theta goes to 0 */
+	glm::vec3 getFresnelColor(const MaterialRecord& material, const HitRecord& hit, float cos_theta)
+	{
+		auto kc = material.color_scale;
+		if (material.color_texture != nullptr)
+			kc = material.color_scale * material.color_texture->sample(hit.tc_u, hit.tc_v);
+		return glm::mix(kc, glm::vec3(1.0f), glm::pow(1.0f - cos_theta, 5.0f));
+	}
+}
 
 /**
  * For polished metals the ray won't be randomly scattered.
@@ -36,47 +55,100 @@
  * select a microfacet normal, m, and then use that normal when computing the reflected direction, i.
  * This will result in reflected directions that are contained in a cone around the mirror direction.
  * The size of the cone depends on the surface roughness.
+ * The microfacet normals follow the GGX distribution, drawn in closed form around the surface normal
+ * (see Sampling.hpp), with alpha = roughness^2 so that the perceived blur grows evenly with the roughness.
+ *
+ * Drawing m with density D(m) |n.m| gives the reflected direction i the density D(m) |n.m| / (4 |o.m|), and the
+ * microfacet BRDF is F G D / (4 |n.o| |n.i|). The weight of the scattered ray, BRDF * |n.i| / density, is therefore
+ * F G |o.m| / (|n.o| |n.m|): D cancels out, and what remains accounts for the facets that are hidden from o or i
+ * by their neighbours (the Smith masking-shadowing term G), which darkens rough metals at grazing angles.
  */
 
-bool Metal::scatter(const Ray& incident,
+bool Metal::scatter(const MaterialRecord& material,
+										const Ray& incident,
 										const HitRecord& hit,
+										const glm::vec2& u,
 										glm::vec3& surface_color,
-										Ray& scattered_ray) const
+										Ray& scattered_ray)
 {
-	// Step 1: Calculate the perfect reflected direction.
-	// The incident direction is inverted because the formula expects a vector pointing away from the surface.
-	auto incident_dir_normalized = glm::normalize(incident.direction);
-	auto reflected = glm::reflect(incident_dir_normalized, hit.normal);
-
-	// Step 2: Implement the Fresnel approximation.
-	// Calculate the cosine of the angle between the incoming ray and the surface normal.
-	// Use the absolute value to handle cases where the ray hits from the back of a thin object.
-	auto cos_theta = glm::dot(-incident_dir_normalized, hit.normal);
+	// Step 1: Pick the microfacet normal: the surface normal itself for a polished metal.
+	auto roughness = getRoughness(material, hit);
 
-	// Calculate the blending weight using the Schlick approximation.
-	float r0 = glm::pow(1.0f - cos_theta, 5.0f);
+	auto microfacet_normal = hit.normal;
+	if (roughness > 0.0f)
+		microfacet_normal = OrthonormalBasis(hit.normal).toWorld(sampleGGX(u, roughness * roughness));
 
-	// Linearly interpolate between the base color and a white color (1.0, 1.0, 1.0).
-	// The Fresnel term determines how much of the white color is blended in.
-	auto kc = color_scale;
-	if (this->color_texture != nullptr)
-		kc = color_scale * color_texture->sample(hit.tc_u, hit.tc_v);
+	// Step 2: Calculate the reflected direction around the microfacet normal.
+	auto incident_dir_normalized = glm::normalize(incident.direction);
+	auto reflected = glm::reflect(incident_dir_normalized, microfacet_normal);
 
-	auto fresnel_color = glm::mix(kc, glm::vec3(1.0f), r0);
+	// Step 3: Implement the Fresnel approximation.
+	// Calculate the cosine of the angle between the incoming ray and the normal of the facet that reflects it.
+	auto cos_theta = glm::max(glm::dot(-incident_dir_normalized, microfacet_normal), 0.0f);
 
-	// Step 3: Set the surface color and scattered ray.
-	surface_color = fresnel_color;
-	scattered_ray = Ray(hit.point, reflected);
+	// Linearly interpolate between the base color and white, with the Schlick weight (1 - cos_theta)^5.
+	auto fresnel_color = getFresnelColor(material, hit, cos_theta);
 
-	// Step 4: Add roughness.
-	// If the material has roughness, add a small random offset to the reflected direction.
-	if (roughness_scale > 0.0f)
+	// Step 4: Weight the Fresnel color by the masking-shadowing of the microfacets.
+	// A polished metal has a single facet, the surface itself, which hides nothing: the weight is 1.
+	auto weight = 1.0f;
+	if (roughness > 0.0f)
 	{
-		auto random_dir = glm::normalize(glm::sphericalRand(roughness_scale));
-		scattered_ray = Ray(hit.point, glm::normalize(reflected + random_dir));
+		auto alpha = roughness * roughness;
+		auto cos_outgoing = glm::dot(-incident_dir_normalized, hit.normal);
+		auto cos_reflected = glm::dot(reflected, hit.normal);
+		auto cos_microfacet = glm::dot(microfacet_normal, hit.normal);
+		auto masking_shadowing = ggxMasking(cos_outgoing, alpha) * ggxMasking(cos_reflected, alpha);
+		weight = masking_shadowing * cos_theta / glm::max(glm::abs(cos_outgoing) * glm::abs(cos_microfacet), 1e-6f);
 	}
 
+	// Step 5: Set the surface color and scattered ray.
+	surface_color = fresnel_color * weight;
+	scattered_ray = Ray(hit.point, reflected);
+
 	// Ensure the scattered ray is on the correct side of the surface.
 	return glm::dot(scattered_ray.direction, hit.normal) > 0;
 }
 
+/**
+ * Light sampling picks the direction i itself, and needs the BRDF and the density of scatter separately.
+ * The microfacet that reflects o into i is the half vector m = normalize(o + i), so
+ * f * cos(n, i) = F G D / (4 |n.o|) and pdf = D(m) |n.m| / (4 |o.m|).
+ * Below SPECULAR_ROUGHNESS the lobe is too narrow for light sampling to ever land in it: the material is a mirror,
+ * whose delta distribution has neither a finite BRDF nor a density, so both are 0.
+ */
+
+glm::vec3 Metal::evaluate(const MaterialRecord& material,
+													const HitRecord& hit,
+													const glm::vec3& outgoing,
+													const glm::vec3& direction)
+{
+	auto roughness = getRoughness(material, hit);
+	auto cos_outgoing = glm::dot(outgoing, hit.normal);
+	auto cos_direction = glm::dot(direction, hit.normal);
+	if (roughness < SPECULAR_ROUGHNESS || cos_outgoing <= 0.0f || cos_direction <= 0.0f)
+		return glm::vec3(0.0f);
+
+	auto alpha = roughness * roughness;
+	auto microfacet_normal = glm::normalize(outgoing + direction);
+	auto cos_theta = glm::max(glm::dot(outgoing, microfacet_normal), 0.0f);
+	auto distribution = ggxDistribution(glm::dot(microfacet_normal, hit.normal), alpha);
+	auto masking_shadowing = ggxMasking(cos_outgoing, alpha) * ggxMasking(cos_direction, alpha);
+	return getFresnelColor(material, hit, cos_theta) * (distribution * masking_shadowing / (4.0f * cos_outgoing));
+}
+
+float Metal::pdf(const MaterialRecord& material,
+								 const HitRecord& hit,
+								 const glm::vec3& outgoing,
+								 const glm::vec3& direction)
+{
+	auto roughness = getRoughness(material, hit);
+	if (roughness < SPECULAR_ROUGHNESS || glm::dot(direction, hit.normal) <= 0.0f)
+		return 0.0f;
+
+	auto microfacet_normal = glm::normalize(outgoing + direction);
+	auto cos_theta = glm::abs(glm::dot(outgoing, microfacet_normal));
+	if (cos_theta <= 0.0f)
+		return 0.0f;
+	return ggxPdf(glm::dot(microfacet_normal, hit.normal), roughness * roughness) / (4.0f * cos_theta);
+}
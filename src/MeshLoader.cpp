@@ -0,0 +1,554 @@
+#include "MeshLoader.hpp"
+#include "MappedFile.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+	/** @brief A vertex of an OBJ face: indices of its position, texture coordinates and normal (-1 if missing) */
+	struct VertexKey
+	{
+		int32_t position;
+		int32_t texture;
+		int32_t normal;
+
+		bool operator==(const VertexKey& other) const = default;
+	};
+
+	struct VertexKeyHash
+	{
+		size_t operator()(const VertexKey& key) const
+		{
+			auto h = static_cast<uint64_t>(static_cast<uint32_t>(key.position));
+			h = h * 0x9e3779b97f4a7c15ULL ^ static_cast<uint32_t>(key.texture);
+			h = h * 0x9e3779b97f4a7c15ULL ^ static_cast<uint32_t>(key.normal);
+			return static_cast<size_t>(h ^ (h >> 32));
+		}
+	};
+
+	/**
+	 * @brief
+	 * Minimal cursor over the file content. Numbers are parsed with std::from_chars, which does not
+	 * depend on the locale and does not allocate, unlike streams or strtof.
+	 */
+	struct Parser
+	{
+		const char* current;
+		const char* end;
+
+		bool atLineEnd() const { return current >= end || *current == '\n' || *current == '#'; }
+
+		void skipSpaces()
+		{
+			while (current < end && (*current == ' ' || *current == '\t' || *current == '\r'))
+				++current;
+		}
+
+		void skipLine()
+		{
+			while (current < end && *current != '\n')
+				++current;
+			if (current < end)
+				++current;
+		}
+
+		bool parseFloat(float& value)
+		{
+			skipSpaces();
+			if (current < end && *current == '+')
+				++current;
+			auto [next, error] = std::from_chars(current, end, value);
+			if (error != std::errc())
+				return false;
+			current = next;
+			return true;
+		}
+
+		bool parseIndex(int64_t& value)
+		{
+			if (current < end && *current == '+')
+				++current;
+			auto [next, error] = std::from_chars(current, end, value);
+			if (error != std::errc())
+				return false;
+			current = next;
+			return true;
+		}
+
+		bool matchKeyword(const char* keyword)
+		{
+			auto p = current;
+			for (; *keyword; ++keyword, ++p)
+				if (p >= end || *p != *keyword)
+					return false;
+			if (p < end && *p != ' ' && *p != '\t')
+				return false;
+			current = p;
+			return true;
+		}
+	};
+
+	constexpr auto mesh_cache_magic = uint32_t{ 0x534d5452 }; // "RTMS"
+	constexpr auto mesh_cache_version = 1u;
+	constexpr auto mesh_cache_alignment = uint64_t{ 64 };
+	enum MeshCacheFlags : uint32_t
+	{
+		HAS_NORMALS = 1u << 0,
+		HAS_TEXTURE_COORDINATES = 1u << 1,
+	};
+
+	struct MeshCacheHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t source_size;						// size and modification time of the OBJ file the cache was made from
+		int64_t source_time;
+		uint64_t file_size;
+		uint32_t vertex_count;
+		uint32_t triangle_count;
+		uint32_t node_count;
+		uint32_t node_size;							// guards against changes of the BVH node layout
+		uint32_t flags;
+		uint32_t padding;
+		uint64_t positions_offset;
+		uint64_t normals_offset;
+		uint64_t texture_coordinates_offset;
+		uint64_t triangles_offset;
+		uint64_t nodes_offset;
+		uint64_t primitive_indices_offset;
+	};
+
+	static_assert(sizeof(glm::vec3) == 12 && sizeof(glm::vec2) == 8 && sizeof(glm::uvec3) == 12);
+
+	/** @brief Size and modification time identify the version of the source file */
+	bool getSourceStamp(const std::filesystem::path& source_path, uint64_t& size, int64_t& time)
+	{
+		auto error = std::error_code{};
+		size = std::filesystem::file_size(source_path, error);
+		if (error)
+			return false;
+		time = std::filesystem::last_write_time(source_path, error).time_since_epoch().count();
+		return !error;
+	}
+
+	uint64_t alignOffset(uint64_t offset)
+	{
+		return (offset + mesh_cache_alignment - 1) / mesh_cache_alignment * mesh_cache_alignment;
+	}
+
+	/** @brief Point the array at count elements of the mapped file, after checking that they lie inside it */
+	template<typename T>
+	bool viewArray(const MappedFile& file, uint64_t offset, uint64_t count, std::span<const T>& array)
+	{
+		array = {};
+		if (count == 0)
+			return true;
+		if (offset % alignof(T) != 0 || offset > file.getSize() || count > (file.getSize() - offset) / sizeof(T))
+			return false;
+		array = std::span<const T>(reinterpret_cast<const T*>(file.getData() + offset), count);
+		return true;
+	}
+
+	/**
+	 * @brief
+	 * Check that every index of the mapped arrays stays inside them, so that a damaged or forged cache cannot make
+	 * the traversal read out of bounds: triangle vertices, the triangle of each primitive slot, the children of
+	 * inner nodes and the slots of leaves. Children must come after their parent, as the builder lays them out,
+	 * which also rules out cycles, and no node may be deeper than the traversal stacks allow (BVH::TRAVERSAL_STACK_SIZE).
+	 */
+	bool validateMeshCache(std::span<const glm::vec3> positions,
+												 std::span<const glm::uvec3> triangles,
+												 std::span<const BVH::Node> nodes,
+												 std::span<const uint32_t> primitive_indices)
+	{
+		for (const auto& triangle : triangles)
+			if (triangle.x >= positions.size() || triangle.y >= positions.size() || triangle.z >= positions.size())
+				return false;
+
+		for (auto index : primitive_indices)
+			if (index >= triangles.size())
+				return false;
+
+		// Parents come first, so the depth of a node is known by the time it is reached
+		auto depths = std::vector<uint32_t>(nodes.size(), 0u);
+		for (auto i = size_t{ 0 }; i < nodes.size(); ++i)
+		{
+			const auto& node = nodes[i];
+			if (node.isLeaf())
+			{
+				if (static_cast<uint64_t>(node.offset) + node.primitive_count > primitive_indices.size())
+					return false;
+				continue;
+			}
+			if (node.offset <= i || static_cast<uint64_t>(node.offset) + 1 >= nodes.size() || depths[i] + 1 >= BVH::TRAVERSAL_STACK_SIZE)
+				return false;
+			depths[node.offset] = glm::max(depths[node.offset], depths[i] + 1);
+			depths[node.offset + 1] = glm::max(depths[node.offset + 1], depths[i] + 1);
+		}
+		return true;
+	}
+
+	/** @brief Unit normal of a planar polygon (Newell's method, robust to collinear vertices), 0 if it is degenerate */
+	glm::vec3 computePolygonNormal(const std::vector<glm::vec3>& positions,
+																 const std::vector<VertexKey>& vertex_keys,
+																 const std::vector<uint32_t>& polygon)
+	{
+		auto normal = glm::vec3(0.f);
+		for (auto i = 0u; i < polygon.size(); ++i)
+		{
+			const auto& current = positions[vertex_keys[polygon[i]].position];
+			const auto& next = positions[vertex_keys[polygon[(i + 1) % polygon.size()]].position];
+			normal += glm::cross(current, next);
+		}
+		auto length = glm::length(normal);
+		return length > 0.f ? normal / length : glm::vec3(0.f);
+	}
+
+	/** @brief OBJ indices start from 1, negative indices count back from the last element */
+	bool resolveIndex(int64_t index, size_t count, int32_t& resolved)
+	{
+		auto value = index < 0 ? static_cast<int64_t>(count) + index : index - 1;
+		if (value < 0 || value >= static_cast<int64_t>(count))
+			return false;
+		resolved = static_cast<int32_t>(value);
+		return true;
+	}
+}
+
+namespace MeshLoader
+{
+	std::shared_ptr<MeshData> loadOBJ(const path& file_path, bool use_cache)
+	{
+		auto cache_path = file_path;
+		cache_path += ".rtmesh";
+		if (use_cache && std::filesystem::exists(cache_path))
+		{
+			auto mesh = loadMeshCache(cache_path, file_path);
+			if (mesh)
+				return mesh;
+		}
+
+		auto start_time = std::chrono::steady_clock::now();
+
+		// Read the whole file at once and parse it in memory
+		auto file = std::ifstream(file_path, std::ios::binary);
+		if (!file)
+		{
+			std::cerr << "Error: cannot open " << file_path << "\n";
+			return nullptr;
+		}
+		auto content = std::string();
+		file.seekg(0, std::ios::end);
+		content.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0, std::ios::beg);
+		file.read(content.data(), content.size());
+
+		auto positions = std::vector<glm::vec3>();
+		auto normals = std::vector<glm::vec3>();
+		auto texture_coordinates = std::vector<glm::vec2>();
+		auto vertex_keys = std::vector<VertexKey>();
+		auto vertex_map = std::unordered_map<VertexKey, uint32_t, VertexKeyHash>();
+		auto mesh = MeshBuffers();
+		auto has_normals = false;
+		auto has_texture_coordinates = false;
+
+		// Geometric normals of the faces with vertices without vn, and the face of each triangle (NO_FACE_NORMAL if not needed)
+		constexpr auto NO_FACE_NORMAL = UINT32_MAX;
+		auto face_normals = std::vector<glm::vec3>();
+		auto triangle_faces = std::vector<uint32_t>();
+
+		auto parser = Parser{ content.data(), content.data() + content.size() };
+		auto polygon = std::vector<uint32_t>();
+		auto line_number = 0u;
+		auto error = [&](const char* message) -> std::shared_ptr<MeshData> {
+			std::cerr << "Error: " << file_path << ":" << line_number << ": " << message << "\n";
+			return nullptr;
+		};
+
+		while (parser.current < parser.end)
+		{
+			++line_number;
+			parser.skipSpaces();
+			if (parser.matchKeyword("v"))
+			{
+				auto p = glm::vec3(0.f);
+				if (!parser.parseFloat(p.x) || !parser.parseFloat(p.y) || !parser.parseFloat(p.z))
+					return error("invalid vertex position");
+				positions.push_back(p);
+			}
+			else if (parser.matchKeyword("vn"))
+			{
+				auto n = glm::vec3(0.f);
+				if (!parser.parseFloat(n.x) || !parser.parseFloat(n.y) || !parser.parseFloat(n.z))
+					return error("invalid vertex normal");
+				normals.push_back(n);
+			}
+			else if (parser.matchKeyword("vt"))
+			{
+				auto tc = glm::vec2(0.f);
+				if (!parser.parseFloat(tc.x))
+					return error("invalid texture coordinates");
+				parser.parseFloat(tc.y); // v is optional
+				texture_coordinates.push_back(tc);
+			}
+			else if (parser.matchKeyword("f"))
+			{
+				// Face vertices: v, v/vt, v//vn or v/vt/vn
+				polygon.clear();
+				auto missing_normal = false;
+				for (parser.skipSpaces(); !parser.atLineEnd(); parser.skipSpaces())
+				{
+					auto key = VertexKey{ -1, -1, -1 };
+					auto index = int64_t{ 0 };
+					if (!parser.parseIndex(index) || !resolveIndex(index, positions.size(), key.position))
+						return error("invalid face position index");
+					if (parser.current < parser.end && *parser.current == '/')
+					{
+						++parser.current;
+						if (parser.current < parser.end && *parser.current != '/')
+						{
+							if (!parser.parseIndex(index) || !resolveIndex(index, texture_coordinates.size(), key.texture))
+								return error("invalid face texture index");
+							has_texture_coordinates = true;
+						}
+						if (parser.current < parser.end && *parser.current == '/')
+						{
+							++parser.current;
+							if (!parser.parseIndex(index) || !resolveIndex(index, normals.size(), key.normal))
+								return error("invalid face normal index");
+							has_normals = true;
+						}
+					}
+
+					missing_normal |= key.normal < 0;
+
+					auto [entry, inserted] = vertex_map.try_emplace(key, static_cast<uint32_t>(vertex_keys.size()));
+					if (inserted)
+						vertex_keys.push_back(key);
+					polygon.push_back(entry->second);
+				}
+				if (polygon.size() < 3)
+					return error("face with less than 3 vertices");
+
+				auto face = NO_FACE_NORMAL;
+				if (missing_normal)
+				{
+					face = static_cast<uint32_t>(face_normals.size());
+					face_normals.push_back(computePolygonNormal(positions, vertex_keys, polygon));
+				}
+				for (auto i = 1u; i + 1 < polygon.size(); ++i)
+				{
+					mesh.triangles.emplace_back(polygon[0], polygon[i], polygon[i + 1]);
+					triangle_faces.push_back(face);
+				}
+			}
+			parser.skipLine();
+		}
+
+		if (mesh.triangles.empty())
+		{
+			std::cerr << "Error: " << file_path << " has no faces\n";
+			return nullptr;
+		}
+
+		// Gather the attributes of each distinct vertex
+		mesh.positions.resize(vertex_keys.size());
+		if (has_normals)
+			mesh.normals.resize(vertex_keys.size(), glm::vec3(0.f));
+		if (has_texture_coordinates)
+			mesh.texture_coordinates.resize(vertex_keys.size(), glm::vec2(0.f));
+		for (auto i = 0u; i < vertex_keys.size(); ++i)
+		{
+			const auto& key = vertex_keys[i];
+			mesh.positions[i] = positions[key.position];
+			if (has_normals && key.normal >= 0)
+				mesh.normals[i] = glm::normalize(normals[key.normal]);
+			if (has_texture_coordinates && key.texture >= 0)
+				mesh.texture_coordinates[i] = texture_coordinates[key.texture];
+		}
+
+		// When some faces have normals and others do not, the vertices without vn take the geometric normal of their face,
+		// so those faces are shaded flat as in a mesh without normals. Such a vertex is shared by faces with different
+		// normals: the first face keeps it, the next ones get a copy.
+		if (has_normals)
+		{
+			auto vertex_faces = std::vector<uint32_t>(vertex_keys.size(), NO_FACE_NORMAL);
+			auto flat_vertices = std::unordered_map<uint64_t, uint32_t>();
+			for (auto i = 0u; i < mesh.triangles.size(); ++i)
+			{
+				auto face = triangle_faces[i];
+				if (face == NO_FACE_NORMAL)
+					continue;
+				auto& triangle = mesh.triangles[i];
+				for (auto corner = 0; corner < 3; ++corner)
+				{
+					auto vertex = triangle[corner];
+					if (vertex_keys[vertex].normal >= 0)
+						continue;
+					auto [entry, inserted] = flat_vertices.try_emplace((static_cast<uint64_t>(face) << 32) | vertex, vertex);
+					if (inserted && vertex_faces[vertex] == NO_FACE_NORMAL)
+					{
+						vertex_faces[vertex] = face;
+						mesh.normals[vertex] = face_normals[face];
+					}
+					else if (inserted)
+					{
+						entry->second = static_cast<uint32_t>(mesh.positions.size());
+						mesh.positions.push_back(mesh.positions[vertex]);
+						mesh.normals.push_back(face_normals[face]);
+						if (has_texture_coordinates)
+							mesh.texture_coordinates.push_back(mesh.texture_coordinates[vertex]);
+					}
+					triangle[corner] = entry->second;
+				}
+			}
+		}
+		auto mesh_data = createMeshData(std::move(mesh));
+
+		const auto end_time = std::chrono::steady_clock::now();
+		const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+		std::cout << "Loaded " << file_path << ": " << mesh_data->positions.size() << " vertices, "
+			<< mesh_data->triangles.size() << " triangles in " << duration.count() << " ms\n";
+
+		if (use_cache)
+			writeMeshCache(cache_path, *mesh_data, file_path);
+		return mesh_data;
+	}
+
+	std::shared_ptr<MeshData> loadMeshCache(const path& cache_path, const path& source_path)
+	{
+		auto start_time = std::chrono::steady_clock::now();
+		auto file = std::make_shared<MappedFile>();
+		if (!file->open(cache_path))
+		{
+			std::cerr << "Error: cannot open " << cache_path << "\n";
+			return nullptr;
+		}
+
+		auto header = MeshCacheHeader{};
+		if (file->getSize() < sizeof(header))
+		{
+			std::cerr << "Error: " << cache_path << " is not a mesh cache\n";
+			return nullptr;
+		}
+		std::memcpy(&header, file->getData(), sizeof(header));
+		if (header.magic != mesh_cache_magic ||
+				header.version != mesh_cache_version ||
+				header.node_size != sizeof(BVH::Node) ||
+				header.file_size != file->getSize())
+		{
+			std::cerr << "Warning: " << cache_path << " was written by a different version, ignoring it\n";
+			return nullptr;
+		}
+
+		if (!source_path.empty())
+		{
+			auto source_size = uint64_t{ 0 };
+			auto source_time = int64_t{ 0 };
+			if (!getSourceStamp(source_path, source_size, source_time) ||
+					source_size != header.source_size ||
+					source_time != header.source_time)
+			{
+				std::cout << "Mesh cache " << cache_path << " is out of date\n";
+				return nullptr;
+			}
+		}
+
+		auto mesh_data = std::make_shared<MeshData>();
+		auto nodes = std::span<const BVH::Node>();
+		auto primitive_indices = std::span<const uint32_t>();
+		auto has_normals = (header.flags & HAS_NORMALS) != 0;
+		auto has_texture_coordinates = (header.flags & HAS_TEXTURE_COORDINATES) != 0;
+		auto valid = viewArray(*file, header.positions_offset, header.vertex_count, mesh_data->positions) &&
+			viewArray(*file, header.normals_offset, has_normals ? header.vertex_count : 0, mesh_data->normals) &&
+			viewArray(*file, header.texture_coordinates_offset, has_texture_coordinates ? header.vertex_count : 0, mesh_data->texture_coordinates) &&
+			viewArray(*file, header.triangles_offset, header.triangle_count, mesh_data->triangles) &&
+			viewArray(*file, header.nodes_offset, header.node_count, nodes) &&
+			viewArray(*file, header.primitive_indices_offset, header.triangle_count, primitive_indices);
+		if (!valid || nodes.empty() || !validateMeshCache(mesh_data->positions, mesh_data->triangles, nodes, primitive_indices))
+		{
+			std::cerr << "Error: " << cache_path << " is corrupted\n";
+			return nullptr;
+		}
+
+		mesh_data->bvh.assign(nodes, primitive_indices, file);
+		mesh_data->storage = file;
+
+		const auto end_time = std::chrono::steady_clock::now();
+		const auto duration = std::chrono::duration<float, std::milli>(end_time - start_time);
+		std::cout << "Mapped " << cache_path << ": " << header.vertex_count << " vertices, "
+			<< header.triangle_count << " triangles in " << duration.count() << " ms\n";
+		return mesh_data;
+	}
+
+	bool writeMeshCache(const path& cache_path, const MeshData& mesh, const path& source_path)
+	{
+		auto header = MeshCacheHeader{};
+		header.magic = mesh_cache_magic;
+		header.version = mesh_cache_version;
+		if (!source_path.empty())
+			getSourceStamp(source_path, header.source_size, header.source_time);
+		header.vertex_count = static_cast<uint32_t>(mesh.positions.size());
+		header.triangle_count = static_cast<uint32_t>(mesh.triangles.size());
+		header.node_count = static_cast<uint32_t>(mesh.bvh.getNodes().size());
+		header.node_size = sizeof(BVH::Node);
+		header.flags = (mesh.normals.empty() ? 0u : HAS_NORMALS) | (mesh.texture_coordinates.empty() ? 0u : HAS_TEXTURE_COORDINATES);
+
+		// Lay the arrays out one after the other, each one starting on a cache line
+		auto offset = alignOffset(sizeof(header));
+		auto place = [&](uint64_t size) -> uint64_t {
+			auto array_offset = offset;
+			offset = alignOffset(offset + size);
+			return array_offset;
+		};
+		header.positions_offset = place(mesh.positions.size_bytes());
+		header.normals_offset = place(mesh.normals.size_bytes());
+		header.texture_coordinates_offset = place(mesh.texture_coordinates.size_bytes());
+		header.triangles_offset = place(mesh.triangles.size_bytes());
+		header.nodes_offset = place(mesh.bvh.getNodes().size_bytes());
+		header.primitive_indices_offset = place(mesh.bvh.getPrimitiveIndices().size_bytes());
+		header.file_size = offset;
+
+		// Write to a temporary file first, so that an interrupted write never leaves a broken cache
+		auto temp_path = cache_path;
+		temp_path += ".tmp";
+		{
+			auto file = std::ofstream(temp_path, std::ios::binary | std::ios::trunc);
+			auto write = [&](uint64_t array_offset, const void* data, uint64_t size) -> void {
+				static const char zeros[mesh_cache_alignment] = {};
+				auto padding = array_offset - static_cast<uint64_t>(file.tellp());
+				file.write(zeros, static_cast<std::streamsize>(padding));
+				file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+			};
+			write(0, &header, sizeof(header));
+			write(header.positions_offset, mesh.positions.data(), mesh.positions.size_bytes());
+			write(header.normals_offset, mesh.normals.data(), mesh.normals.size_bytes());
+			write(header.texture_coordinates_offset, mesh.texture_coordinates.data(), mesh.texture_coordinates.size_bytes());
+			write(header.triangles_offset, mesh.triangles.data(), mesh.triangles.size_bytes());
+			write(header.nodes_offset, mesh.bvh.getNodes().data(), mesh.bvh.getNodes().size_bytes());
+			write(header.primitive_indices_offset, mesh.bvh.getPrimitiveIndices().data(), mesh.bvh.getPrimitiveIndices().size_bytes());
+			write(header.file_size, nullptr, 0);
+			if (!file)
+			{
+				std::cerr << "Error: cannot write mesh cache " << temp_path << "\n";
+				return false;
+			}
+		}
+
+		auto error = std::error_code{};
+		std::filesystem::rename(temp_path, cache_path, error);
+		if (error)
+		{
+			std::cerr << "Error: cannot write mesh cache " << cache_path << ": " << error.message() << "\n";
+			return false;
+		}
+		return true;
+	}
+}
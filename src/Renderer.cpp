@@ -1,14 +1,13 @@
 #include "Renderer.hpp"
 #include "Scene.hpp"
 #include "Ray.hpp"
-#include "Material/IMaterial.hpp"
-#include "Material/Emissive.hpp"
+#include "Sampler/ISampler.hpp"
+#include "Material/MaterialTable.hpp"
 
 #include "Geometry/Sphere.hpp"
 #include "Geometry/Plane.hpp"
 
 #include <limits>
-#include <glm/gtx/norm.hpp>		// glm::length2
 
 /**
  * ============================================
@@ -107,62 +106,213 @@
  * rays may hit an occluder, forming a visible shadow.
  */
 
+/**
+ * The recursive formulation above can be unrolled into a loop.
+ * Each bounce multiplies the light carried back to the camera by the surface color k_c, so instead of
+ * recursing we keep the product of all the colors met along the path, called path throughput, and add
+ * throughput * (L_e + direct illumination) at each vertex.
+ *
+ * The loop also makes it easy to stop paths whose contribution has become negligible.
+ * Russian roulette terminates the path with probability 1 - q after a minimum number of bounces,
+ * and divides the throughput of the surviving paths by q, so that the estimate stays unbiased:
+ * E[L] = q * (L / q) + (1 - q) * 0 = L
+ * Choosing q proportional to the throughput kills dark paths early and keeps the bright ones.
+ *
+ * Direct illumination is estimated twice at each vertex, and the two estimates are combined with
+ * multiple importance sampling (Veach and Guibas, "Optimally Combining Sampling Techniques for Monte Carlo Rendering", 1995):
+ *	- light sampling (next-event estimation): a point is picked on each light, with density p_light per unit solid angle,
+ *		and if a shadow ray reaches it, it adds f * cos * L_e * w_light / p_light;
+ *	- BSDF sampling: the scattered ray may hit a light by itself, and then adds L_e * w_bsdf (the throughput
+ *		already holds f * cos / p_bsdf).
+ * With the power heuristic, w_light = p_light^2 / (p_light^2 + p_bsdf^2) and w_bsdf = p_bsdf^2 / (p_bsdf^2 + p_light^2):
+ * the weights of a direction sum to one, so light is counted once, and each technique dominates where it is good,
+ * light sampling for small lights and BSDF sampling for large lights seen by glossy surfaces.
+ * Specular bounces cannot be reached by light sampling, so lights found after them keep their full weight.
+ *
+ * Sampling every light costs one shadow ray per light and per vertex. With many lights, a single light can be
+ * chosen at random instead, with probability P(l): dividing its contribution by P(l) keeps the estimate unbiased,
+ * and p_light becomes P(l) * p_surface in the MIS weights. Choosing P(l) proportional to the power of the lights
+ * spends the shadow rays on the lights that matter most, and the cost no longer depends on the number of lights.
+ */
+
 glm::vec3 Renderer::computeRayColor(const Ray& ray, 
 																		const Scene& scene, 
-																		uint32_t depth) const
+																		ISampler& sampler,
+																		uint32_t max_depth,
+																		uint32_t russian_roulette_depth,
+																		LightSelection light_selection,
+																		AuxiliarySample* auxiliary) const
 {
-	if (depth <= 0)
-		return glm::vec3(0.f);
-
 	constexpr auto t_min = 1e-3;
 	constexpr auto t_max = std::numeric_limits<float>::infinity();
+
+	auto radiance = glm::vec3(0.f);
+	auto throughput = glm::vec3(1.f);
+	auto current_ray = ray;
+	auto bsdf_pdf = 0.f;		// density of the direction of current_ray, 0 for the camera ray and after specular bounces
+	const auto& materials = scene.getMaterialTable();
+	const auto light_sample_count = getLightSampleCount(scene, light_selection);
 	auto hit_record = HitRecord{};
-	if (!scene.rayCasting(ray, t_min, t_max, hit_record))
+	auto auxiliary_pending = auxiliary != nullptr;		// no non-specular hit yet
+	auto auxiliary_albedo = glm::vec3(1.f);
+	auto auxiliary_distance = 0.f;
+	if (auxiliary)
+		*auxiliary = AuxiliarySample{};
+	for (auto depth = 0u; depth < max_depth; ++depth)
 	{
-		return glm::vec3(0.f);
-		//auto unit_direction = glm::normalize(ray.direction);
-		//auto a = (unit_direction.y + 1.0f) * 0.5f;
-		//return glm::mix(glm::vec3(1.f), glm::vec3(0.5f, 0.7f, 1.0f), a); // linear interpolation between blue and white
-	}
+		if (!scene.rayCasting(current_ray, t_min, t_max, hit_record))
+		{
+			break;
+			//auto unit_direction = glm::normalize(current_ray.direction);
+			//auto a = (unit_direction.y + 1.0f) * 0.5f;
+			//radiance += throughput * glm::mix(glm::vec3(1.f), glm::vec3(0.5f, 0.7f, 1.0f), a); // linear interpolation between blue and white
+		}
+		if (auxiliary_pending)
+		{
+			auxiliary_distance += glm::length(hit_record.point - current_ray.origin);
+			auxiliary_pending = materials.isSpecular(hit_record.material_id);
+			if (!auxiliary_pending)
+				*auxiliary = computeAuxiliarySample(scene, hit_record, auxiliary_albedo, auxiliary_distance);
+		}
 
-	// 1. Luce emessa dalla superficie stessa (se � una sorgente luminosa)
-	auto emitted_color = hit_record.material->emitted(hit_record.tc_u, hit_record.tc_v);
-	auto scattered_ray = Ray();
-	auto material_scatter_color = glm::vec3();
-	// Se il materiale non disperde luce (es. � una luce pura), restituiamo solo il colore emesso.
-	if (!hit_record.material->scatter(ray, hit_record, material_scatter_color, scattered_ray))
-		return emitted_color;
-
-	// 2. Illuminazione Diretta: campionamento esplicito delle luci
-	auto direct_illumination = glm::vec3(0.0f);
-	auto lights = scene.getEmissiveObjects();
-	for (const auto& light : lights)
-	{
-		auto to_light_direction = glm::normalize(light->getPosition() - hit_record.point);
-		auto shadow_ray = Ray(hit_record.point, to_light_direction);
-		auto shadow_hit_record = HitRecord{};
-		if (!scene.rayCasting(shadow_ray, t_min, glm::distance(light->getPosition(), hit_record.point), shadow_hit_record))
+		// 1. Luce emessa dalla superficie stessa (se è una sorgente luminosa), pesata rispetto al campionamento delle luci
+		auto emitted_color = materials.emitted(hit_record.material_id, hit_record.tc_u, hit_record.tc_v);
+		radiance += throughput * emitted_color * computeEmissionWeight(scene, light_selection, hit_record.light_id, current_ray.origin, hit_record.point, bsdf_pdf);
+
+		auto scattered_ray = Ray();
+		auto material_scatter_color = glm::vec3();
+		auto scatters = materials.scatter(hit_record.material_id, current_ray, hit_record, sampler.get2D(), material_scatter_color, scattered_ray);
+		if (!scatters && !materials.isGlossy(hit_record.material_id))
+			break;
+
+		// 2. Illuminazione Diretta: campionamento esplicito delle luci
+		// Specular surfaces sample no light, but skip the dimensions of the light samples all the same (see ISampler)
+		auto is_specular = materials.isSpecular(hit_record.material_id);
+		auto outgoing = -glm::normalize(current_ray.direction);
+		auto direct_illumination = glm::vec3(0.0f);
+		if (is_specular)
+			sampler.skipDimensions(getLightSamplingDimensions(scene, light_selection));
+		else
 		{
-			auto emissive_light = std::dynamic_pointer_cast<Emissive>(light);
-			auto light_source_color = emissive_light->emission_scale;
-			auto distance_squared = glm::length(light->getPosition() - hit_record.point);
-			distance_squared *= distance_squared;
+			for (auto light_sample = 0u; light_sample < light_sample_count; ++light_sample)
+			{
+				auto selection_pmf = 0.f;
+				auto light_index = selectLight(scene, light_selection, light_sample, sampler, selection_pmf);
+				auto u = sampler.get2D();
+				auto to_light_direction = glm::vec3();
+				auto shadow_distance = 0.f;
+				auto contribution = glm::vec3();
+				if (sampleLight(scene, light_index, selection_pmf, hit_record, outgoing, u, to_light_direction, shadow_distance, contribution) &&
+						!scene.occluded(Ray(hit_record.point, to_light_direction), t_min, shadow_distance))
+					direct_illumination += contribution;
+			}
+		}
+		radiance += throughput * direct_illumination;
+		if (!scatters)
+			break;
+		if (auxiliary_pending)
+			auxiliary_albedo *= material_scatter_color;
 
-			auto attenuation = light_source_color / distance_squared;
-			auto cosine_term = glm::max(glm::dot(hit_record.normal, to_light_direction), 0.0f);
+		// 3. Illuminazione Indiretta: il rimbalzo continua lungo il raggio diffuso,
+		// pesato dal prodotto dei colori incontrati finora.
+		throughput *= material_scatter_color;
+		bsdf_pdf = is_specular ? 0.f : materials.pdf(hit_record.material_id, hit_record, outgoing, scattered_ray.direction);
 
-			// Qui si moltiplica la luce diretta per il fattore di riflettanza del materiale.
-			direct_illumination += material_scatter_color * attenuation * cosine_term;
+		// 4. Russian roulette, whose dimension is drawn at every bounce
+		auto survival_u = sampler.get1D();
+		if (depth + 1 >= russian_roulette_depth)
+		{
+			auto survival_probability = glm::min(glm::max(throughput.r, glm::max(throughput.g, throughput.b)), 0.95f);
+			if (survival_u >= survival_probability)
+				break;
+			throughput /= survival_probability;
 		}
+		current_ray = scattered_ray;
+	}
+	return radiance;
+}
+
+AuxiliarySample Renderer::computeAuxiliarySample(const Scene& scene,
+																									const HitRecord& hit,
+																									const glm::vec3& specular_albedo,
+																									float distance)
+{
+	auto sample = AuxiliarySample{};
+	sample.albedo = specular_albedo * scene.getMaterialTable().albedo(hit.material_id, hit);
+	sample.normal = hit.normal;
+	sample.depth = distance;
+	return sample;
+}
+
+uint32_t Renderer::getLightSampleCount(const Scene& scene, LightSelection light_selection)
+{
+	// Lights are only selected by power once the scene is built
+	auto light_count = static_cast<uint32_t>(scene.getLights().size());
+	return light_selection == LightSelection::ALL ? light_count : (scene.getLightDistribution().empty() ? 0u : 1u);
+}
+
+uint32_t Renderer::getLightSamplingDimensions(const Scene& scene, LightSelection light_selection)
+{
+	return getLightSampleCount(scene, light_selection) * (light_selection == LightSelection::POWER ? 3u : 2u);
+}
+
+uint32_t Renderer::selectLight(const Scene& scene,
+															 LightSelection light_selection,
+															 uint32_t index,
+															 ISampler& sampler,
+															 float& selection_pmf)
+{
+	if (light_selection == LightSelection::ALL)
+	{
+		selection_pmf = 1.f;
+		return index;
 	}
+	return scene.getLightDistribution().sample(sampler.get1D(), selection_pmf);
+}
 
-	// 3. Illuminazione Indiretta: il rimbalzo ricorsivo
-	// Si usa la ricorsione per calcolare l'illuminazione che proviene da altre superfici.
-	auto indirect_illumination = material_scatter_color * computeRayColor(scattered_ray, scene, depth - 1);
+bool Renderer::sampleLight(const Scene& scene,
+													 uint32_t light_id,
+													 float selection_pmf,
+													 const HitRecord& hit,
+													 const glm::vec3& outgoing,
+													 const glm::vec2& u,
+													 glm::vec3& direction,
+													 float& shadow_distance,
+													 glm::vec3& contribution)
+{
+	const auto& light = scene.getLights()[light_id];
+	auto sample = LightSample{};
+	if (!light.object->sampleSurface(hit.point, u, sample))
+		return false;
+	auto light_pdf = selection_pmf * sample.pdf;
 
-	// 4. Risultato finale: somma di tutti i contributi
-	// Si sommano i contributi diretti e indiretti, e si aggiunge la luce emessa.
-	return emitted_color + direct_illumination + indirect_illumination;
+	const auto& materials = scene.getMaterialTable();
+	auto to_light = sample.point - hit.point;
+	auto distance = glm::length(to_light);
+	direction = to_light / distance;
+	auto scattering = materials.evaluate(hit.material_id, hit, outgoing, direction);
+	if (scattering == glm::vec3(0.f))
+		return false;
+
+	auto emitted_color = materials.emitted(light.material_id, sample.texture_coordinates.x, sample.texture_coordinates.y);
+	auto weight = powerHeuristic(light_pdf, materials.pdf(hit.material_id, hit, outgoing, direction));
+	contribution = scattering * emitted_color * (weight / light_pdf);
+	shadow_distance = distance * (1.f - 1e-3f);
+	return true;
+}
+
+float Renderer::computeEmissionWeight(const Scene& scene,
+																			LightSelection light_selection,
+																			uint32_t light_id,
+																			const glm::vec3& origin,
+																			const glm::vec3& point,
+																			float bsdf_pdf)
+{
+	if (light_id == Scene::NO_LIGHT || bsdf_pdf == 0.f || getLightSampleCount(scene, light_selection) == 0)
+		return 1.f;
+	auto selection_pmf = light_selection == LightSelection::ALL ? 1.f : scene.getLightDistribution().getPmf(light_id);
+	auto light_pdf = selection_pmf * scene.getLights()[light_id].object->getSurfacePdf(origin, point);
+	return powerHeuristic(bsdf_pdf, light_pdf);
 }
 
 
@@ -0,0 +1,56 @@
+#include "Sampler/AliasTable.hpp"
+
+/**
+ * ============================================
+ *		PUBLIC
+ * ============================================
+ */
+
+void AliasTable::build(std::span<const float> weights)
+{
+	const auto count = static_cast<uint32_t>(weights.size());
+	__bins.assign(count, Bin{ 1.f, 0u, 0.f });
+	if (count == 0)
+		return;
+
+	auto total = 0.0;
+	for (auto weight : weights)
+		total += weight > 0.f ? weight : 0.f;
+
+	// Probability of each item scaled by n: an average bin holds exactly 1
+	auto scaled = std::vector<double>(count);
+	for (auto i = 0u; i < count; ++i)
+	{
+		auto pmf = total > 0.0 ? (weights[i] > 0.f ? weights[i] / total : 0.0) : 1.0 / count;
+		__bins[i].pmf = static_cast<float>(pmf);
+		scaled[i] = pmf * count;
+	}
+
+	// Vose: every bin under 1 is filled up with the excess of a bin over 1
+	auto under = std::vector<uint32_t>();
+	auto over = std::vector<uint32_t>();
+	for (auto i = 0u; i < count; ++i)
+		(scaled[i] < 1.0 ? under : over).push_back(i);
+
+	while (!under.empty() && !over.empty())
+	{
+		auto small = under.back();
+		auto large = over.back();
+		under.pop_back();
+		__bins[small].probability = static_cast<float>(scaled[small]);
+		__bins[small].alias = large;
+
+		scaled[large] -= 1.0 - scaled[small];
+		if (scaled[large] < 1.0)
+		{
+			over.pop_back();
+			under.push_back(large);
+		}
+	}
+
+	// What remains is 1 up to rounding errors: those bins keep their own item
+	for (auto i : under)
+		__bins[i] = Bin{ 1.f, i, __bins[i].pmf };
+	for (auto i : over)
+		__bins[i] = Bin{ 1.f, i, __bins[i].pmf };
+}
@@ -0,0 +1,167 @@
+#include "Sampler/BlueNoiseSampler.hpp"
+#include "Sampler/LowDiscrepancy.hpp"
+
+#include <vector>
+#include <cmath>
+
+namespace
+{
+	constexpr auto mask_size = 64u;		// a power of two, so that the tile wraps with a mask
+	constexpr auto mask_pixel_count = mask_size * mask_size;
+
+	/**
+	 * Void-and-cluster. The energy of a pixel is the sum, over the points of a binary pattern, of a Gaussian of
+	 * their toroidal distance: it is high in clusters and low in voids.
+	 *	1. A random initial pattern is relaxed by moving its tightest cluster to its largest void until they coincide.
+	 *	2. Its points are ranked by removing the tightest cluster one at a time (the last removed gets rank 0).
+	 *	3. From the initial pattern again, the largest void is filled one at a time, up to the full tile.
+	 * The ranks, normalized, are the mask: every threshold of it is an evenly spread pattern.
+	 * (Past half the tile, Ulichney looks for the tightest cluster of the empty pixels: the energy of the empty pixels
+	 * is a constant minus the energy of the points, so this is also the largest void.)
+	 */
+	std::vector<float> buildBlueNoiseMask()
+	{
+		constexpr auto sigma = 1.5f;
+		auto kernel = std::vector<float>(mask_pixel_count);
+		for (auto y = 0u; y < mask_size; ++y)
+		{
+			for (auto x = 0u; x < mask_size; ++x)
+			{
+				auto dx = static_cast<float>(glm::min(x, mask_size - x));
+				auto dy = static_cast<float>(glm::min(y, mask_size - y));
+				kernel[y * mask_size + x] = std::exp(-(dx * dx + dy * dy) / (2.f * sigma * sigma));
+			}
+		}
+
+		auto pattern = std::vector<uint8_t>(mask_pixel_count, 0u);
+		auto energy = std::vector<float>(mask_pixel_count, 0.f);
+		auto set = [&](uint32_t pixel, bool value) -> void {
+			pattern[pixel] = value;
+			auto sign = value ? 1.f : -1.f;
+			auto px = pixel % mask_size;
+			auto py = pixel / mask_size;
+			for (auto y = 0u; y < mask_size; ++y)
+				for (auto x = 0u; x < mask_size; ++x)
+					energy[y * mask_size + x] += sign * kernel[((y - py) & (mask_size - 1)) * mask_size + ((x - px) & (mask_size - 1))];
+		};
+		auto find_tightest_cluster = [&]() -> uint32_t {
+			auto best = 0u;
+			auto best_energy = -1.f;
+			for (auto i = 0u; i < mask_pixel_count; ++i)
+				if (pattern[i] && energy[i] > best_energy)
+					best = i, best_energy = energy[i];
+			return best;
+		};
+		auto find_largest_void = [&]() -> uint32_t {
+			auto best = 0u;
+			auto best_energy = INFINITY;
+			for (auto i = 0u; i < mask_pixel_count; ++i)
+				if (!pattern[i] && energy[i] < best_energy)
+					best = i, best_energy = energy[i];
+			return best;
+		};
+
+		// 1. Initial pattern, with a tenth of the pixels
+		const auto initial_count = mask_pixel_count / 10u;
+		auto rng = PCG32(0x5eedu);
+		for (auto placed = 0u; placed < initial_count;)
+		{
+			auto pixel = rng.nextUInt() % mask_pixel_count;
+			if (!pattern[pixel])
+			{
+				set(pixel, true);
+				++placed;
+			}
+		}
+		while (true)
+		{
+			auto cluster = find_tightest_cluster();
+			set(cluster, false);
+			auto largest_void = find_largest_void();
+			set(largest_void, true);
+			if (largest_void == cluster)
+				break;
+		}
+		auto initial_pattern = pattern;
+		auto initial_energy = energy;
+
+		// 2. Rank the initial points
+		auto ranks = std::vector<uint32_t>(mask_pixel_count);
+		for (auto rank = initial_count; rank-- > 0u;)
+		{
+			auto cluster = find_tightest_cluster();
+			set(cluster, false);
+			ranks[cluster] = rank;
+		}
+
+		// 3. Fill the voids
+		pattern = initial_pattern;
+		energy = initial_energy;
+		for (auto rank = initial_count; rank < mask_pixel_count; ++rank)
+		{
+			auto largest_void = find_largest_void();
+			set(largest_void, true);
+			ranks[largest_void] = rank;
+		}
+
+		auto mask = std::vector<float>(mask_pixel_count);
+		for (auto i = 0u; i < mask_pixel_count; ++i)
+			mask[i] = (static_cast<float>(ranks[i]) + 0.5f) / static_cast<float>(mask_pixel_count);
+		return mask;
+	}
+
+	/** Shift u by offset, modulo 1 */
+	float shiftModulo(float u, float offset)
+	{
+		auto shifted = u + offset;
+		return shifted >= 1.f ? shifted - 1.f : shifted;
+	}
+}
+
+/**
+ * ============================================
+ *		PUBLIC
+ * ============================================
+ */
+
+BlueNoiseSampler::BlueNoiseSampler(uint64_t seed) : ISampler(seed)
+{
+	// Built on first use, once for all the samplers (the initialization of a local static is thread-safe)
+	static const auto mask = buildBlueNoiseMask();
+	__mask = mask.data();
+}
+
+float BlueNoiseSampler::compute1D(const glm::uvec2& pixel, uint32_t sample_index, uint32_t dimension) const
+{
+	// The hash does not depend on the pixel: all pixels share the same points
+	auto hash = hashSample(__seed, glm::uvec2(0u), 0u, dimension);
+	auto index = owenScramble(sample_index, static_cast<uint32_t>(hash));
+	auto u = toUnitFloat(owenScramble(sobol2D(index).x, static_cast<uint32_t>(hash >> 32)));
+	return shiftModulo(u, __getShift(pixel, static_cast<uint32_t>(hashSeed(hash))));
+}
+
+glm::vec2 BlueNoiseSampler::compute2D(const glm::uvec2& pixel, uint32_t sample_index, uint32_t dimension) const
+{
+	auto hash = hashSample(__seed, glm::uvec2(0u), 0u, dimension);
+	auto index = owenScramble(sample_index, static_cast<uint32_t>(hash));
+	auto point = sobol2D(index);
+	auto value_hash = hashSeed(hash);
+	auto u = glm::vec2(toUnitFloat(owenScramble(point.x, static_cast<uint32_t>(value_hash))),
+										 toUnitFloat(owenScramble(point.y, static_cast<uint32_t>(value_hash >> 32))));
+	auto offset_hash = hashSeed(value_hash);
+	return glm::vec2(shiftModulo(u.x, __getShift(pixel, static_cast<uint32_t>(offset_hash))),
+									 shiftModulo(u.y, __getShift(pixel, static_cast<uint32_t>(offset_hash >> 32))));
+}
+
+/**
+ * ============================================
+ *		PRIVATE
+ * ============================================
+ */
+
+float BlueNoiseSampler::__getShift(const glm::uvec2& pixel, uint32_t offset_seed) const
+{
+	auto x = (pixel.x + offset_seed) & (mask_size - 1u);
+	auto y = (pixel.y + (offset_seed >> 16)) & (mask_size - 1u);
+	return __mask[y * mask_size + x];
+}
@@ -0,0 +1,19 @@
+#include "Sampler/IndependentSampler.hpp"
+#include "Sampler/LowDiscrepancy.hpp"
+
+/**
+ * ============================================
+ *		PUBLIC
+ * ============================================
+ */
+
+float IndependentSampler::compute1D(const glm::uvec2& pixel, uint32_t sample_index, uint32_t dimension) const
+{
+	return toUnitFloat(static_cast<uint32_t>(hashSample(__seed, pixel, sample_index, dimension)));
+}
+
+glm::vec2 IndependentSampler::compute2D(const glm::uvec2& pixel, uint32_t sample_index, uint32_t dimension) const
+{
+	auto hash = hashSample(__seed, pixel, sample_index, dimension);
+	return glm::vec2(toUnitFloat(static_cast<uint32_t>(hash)), toUnitFloat(static_cast<uint32_t>(hash >> 32)));
+}
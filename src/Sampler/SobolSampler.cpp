@@ -0,0 +1,25 @@
+#include "Sampler/SobolSampler.hpp"
+#include "Sampler/LowDiscrepancy.hpp"
+
+/**
+ * ============================================
+ *		PUBLIC
+ * ============================================
+ */
+
+float SobolSampler::compute1D(const glm::uvec2& pixel, uint32_t sample_index, uint32_t dimension) const
+{
+	auto hash = hashSample(__seed, pixel, 0u, dimension);
+	auto index = owenScramble(sample_index, static_cast<uint32_t>(hash));
+	return toUnitFloat(owenScramble(sobol2D(index).x, static_cast<uint32_t>(hash >> 32)));
+}
+
+glm::vec2 SobolSampler::compute2D(const glm::uvec2& pixel, uint32_t sample_index, uint32_t dimension) const
+{
+	auto hash = hashSample(__seed, pixel, 0u, dimension);
+	auto index = owenScramble(sample_index, static_cast<uint32_t>(hash));
+	auto point = sobol2D(index);
+	auto value_hash = hashSeed(hash);
+	return glm::vec2(toUnitFloat(owenScramble(point.x, static_cast<uint32_t>(value_hash))),
+									 toUnitFloat(owenScramble(point.y, static_cast<uint32_t>(value_hash >> 32))));
+}
@@ -0,0 +1,39 @@
+#include "Sampler/StratifiedSampler.hpp"
+#include "Sampler/LowDiscrepancy.hpp"
+
+#include <cmath>
+
+/**
+ * ============================================
+ *		PUBLIC
+ * ============================================
+ */
+
+StratifiedSampler::StratifiedSampler(uint32_t samples_per_pixel, uint64_t seed) :
+	ISampler(seed),
+	__samples_per_pixel{ glm::max(samples_per_pixel, 1u) }
+{
+	__grid.x = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(__samples_per_pixel))));
+	__grid.y = (__samples_per_pixel + __grid.x - 1u) / __grid.x;
+}
+
+float StratifiedSampler::compute1D(const glm::uvec2& pixel, uint32_t sample_index, uint32_t dimension) const
+{
+	// The order of the strata and the jitter change with each round of samples_per_pixel samples
+	auto round = sample_index / __samples_per_pixel;
+	auto hash = hashSeed(hashSample(__seed, pixel, round, dimension));
+	auto stratum = permuteIndex(sample_index % __samples_per_pixel, __samples_per_pixel, static_cast<uint32_t>(hash));
+	auto jitter = toUnitFloat(static_cast<uint32_t>(hashSample(hash, pixel, sample_index, dimension)));
+	return glm::min((static_cast<float>(stratum) + jitter) / static_cast<float>(__samples_per_pixel), ONE_MINUS_EPSILON);
+}
+
+glm::vec2 StratifiedSampler::compute2D(const glm::uvec2& pixel, uint32_t sample_index, uint32_t dimension) const
+{
+	auto round = sample_index / __samples_per_pixel;
+	auto hash = hashSeed(hashSample(__seed, pixel, round, dimension));
+	auto cell = permuteIndex(sample_index % __samples_per_pixel, __grid.x * __grid.y, static_cast<uint32_t>(hash));
+	auto jitter_hash = hashSample(hash, pixel, sample_index, dimension);
+	auto jitter = glm::vec2(toUnitFloat(static_cast<uint32_t>(jitter_hash)), toUnitFloat(static_cast<uint32_t>(jitter_hash >> 32)));
+	auto u = (glm::vec2(cell % __grid.x, cell / __grid.x) + jitter) / glm::vec2(__grid);
+	return glm::min(u, glm::vec2(ONE_MINUS_EPSILON));
+}
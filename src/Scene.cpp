@@ -1,15 +1,67 @@
 #include "Scene.hpp"
 #include "Ray.hpp"
-#include "Material/Emissive.hpp"
+
+#include <iostream>
 
 void Scene::add(std::shared_ptr<IHittableObject> object)
 {
 	__objects.push_back(object);
+	__bvh.clear();
+	__bvh4.clear();
+	__compiled.clear();
+	__light_distribution.clear();
+
+	auto materials = std::vector<const IMaterial*>();
+	object->collectMaterials(materials);
+	__materials.add(materials);
+	object->assignMaterialIds(__materials);
+
+	const auto& material = object->getMaterial();
+	if (material && material->getType() == MaterialType::EMISSIVE)
+	{
+		object->setLightId(static_cast<uint32_t>(__lights.size()));
+		__lights.push_back(LightSource{ object->getPosition(), material->emission_scale, object.get(), object->getMaterialId() });
+	}
 }
 
 void Scene::clear()
 {
+	for (const auto& light : __lights)
+		light.object->setLightId(NO_LIGHT);
 	__objects.clear();
+	__lights.clear();
+	__light_distribution.clear();
+	__materials.clear();
+	__bvh.clear();
+	__bvh4.clear();
+	__compiled.clear();
+}
+
+void Scene::build()
+{
+	auto bounds = std::vector<AABB>();
+	bounds.reserve(__objects.size());
+	for (const auto& object : __objects)
+		bounds.push_back(object->getBoundingBox());
+	__bvh.build(bounds);
+	__bvh4.build(__bvh);
+
+	// Sorting the materials changes their ids: update the objects before they are copied
+	__materials.build();
+	for (const auto& object : __objects)
+		object->assignMaterialIds(__materials);
+
+	// Copy the objects in leaf order: a leaf reads a contiguous range of slots
+	__compiled.build(__objects, __bvh.getPrimitiveIndices());
+
+	for (auto& light : __lights)
+		light.material_id = light.object->getMaterialId();
+	__buildLightDistribution();
+
+	const auto& stats = __bvh.getBuildStats();
+	std::cout << "BVH built over " << __objects.size() << " objects in " << stats.build_time_ms << " ms"
+		<< " (" << stats.node_count << " nodes, " << stats.leaf_count << " leaves, depth " << stats.max_depth
+		<< ", " << stats.thread_count << " threads)\n";
 }
 
 bool Scene::rayCasting(const Ray& ray,
@@ -17,30 +69,82 @@ bool Scene::rayCasting(const Ray& ray,
 											 float t_max,
 											 HitRecord& record) const
 {
-	auto rec = HitRecord{};
 	auto hit = false;
 	auto closest_tmax = t_max;
-	for (const auto& object : __objects)
+
+	// Objects only write the record when they are hit, so it is filled in place by each closer candidate.
+	// Without an acceleration structure, every object has to be tested.
+	if (!__bvh.isBuilt())
 	{
-		if (object->intersect(ray, t_min, closest_tmax, rec))
+		for (const auto& object : __objects)
 		{
-			hit = true;
-			closest_tmax = rec.t;
-			record = rec;
+			if (object->intersect(ray, t_min, closest_tmax, record))
+			{
+				hit = true;
+				closest_tmax = record.t;
+			}
 		}
 	}
+	else
+	{
+		auto intersect_object = [&](uint32_t slot, float t_near, float& t_far) -> bool {
+			if (!__compiled.intersect(slot, ray, t_near, t_far, record))
+				return false;
+			t_far = record.t;
+			return true;
+		};
+		if (__traversal_kernel == TraversalKernel::WIDE_4)
+			hit = __bvh4.intersect(ray, t_min, closest_tmax, intersect_object);
+		else
+			hit = __bvh.intersect(ray, t_min, closest_tmax, intersect_object);
+	}
+
+	// Candidates only record what was hit: the surface is evaluated once, for the closest one
+	if (hit)
+		record.getNextObject()->computeSurfaceInteraction(ray, record);
 	return hit;
 }
 
+bool Scene::occluded(const Ray& ray,
+										 float t_min,
+										 float t_max) const
+{
+	if (!__bvh.isBuilt())
+	{
+		for (const auto& object : __objects)
+			if (object->occludes(ray, t_min, t_max))
+				return true;
+		return false;
+	}
+
+	auto occludes_object = [&](uint32_t slot, float t_near, float t_far) -> bool {
+		return __compiled.occludes(slot, ray, t_near, t_far);
+	};
+	if (__traversal_kernel == TraversalKernel::WIDE_4)
+		return __bvh4.occluded(ray, t_min, t_max, occludes_object);
+	return __bvh.occluded(ray, t_min, t_max, occludes_object);
+}
+
 std::vector<std::shared_ptr<IHittableObject>> Scene::getEmissiveObjects() const
 {
 	std::vector<std::shared_ptr<IHittableObject>> emissive_objects;
 	for (const auto& object : __objects)
 	{
 		const auto& material = object->getMaterial();
-		auto emissive_material = std::dynamic_pointer_cast<Emissive>(material);
-		if (emissive_material)
+		if (material && material->getType() == MaterialType::EMISSIVE)
 			emissive_objects.push_back(object);
 	}
 	return emissive_objects;
 }
+
+void Scene::__buildLightDistribution()
+{
+	auto powers = std::vector<float>();
+	powers.reserve(__lights.size());
+	for (const auto& light : __lights)
+	{
+		auto luminance = glm::dot(light.emission, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+		powers.push_back(luminance * light.object->getSurfaceArea());
+	}
+	__light_distribution.build(powers);
+}
@@ -0,0 +1,76 @@
+#include "ThreadPool.hpp"
+
+/**
+ * ============================================
+ *		PUBLIC
+ * ============================================
+ */
+
+ThreadPool::ThreadPool(uint32_t thread_count)
+{
+	for (auto thread = 1u; thread < thread_count; ++thread)
+		__workers.emplace_back(&ThreadPool::__workerLoop, this, thread);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		auto lock = std::lock_guard(__mutex);
+		__stopping = true;
+	}
+	__job_ready.notify_all();
+
+	// Join the workers here: they use the mutex and the condition variables, which are destroyed before __workers
+	__workers.clear();
+}
+
+/**
+ * ============================================
+ *		PRIVATE
+ * ============================================
+ */
+
+void ThreadPool::__run(void (*job)(void*, uint32_t), void* context)
+{
+	{
+		auto lock = std::lock_guard(__mutex);
+		__job = job;
+		__job_context = context;
+		__busy_workers = static_cast<uint32_t>(__workers.size());
+		++__job_generation;
+	}
+	__job_ready.notify_all();
+
+	job(context, 0u);
+
+	// The job lives on the stack of the caller: wait until no worker can still be running it
+	auto lock = std::unique_lock(__mutex);
+	__job_done.wait(lock, [&] { return __busy_workers == 0; });
+	__job = nullptr;
+	__job_context = nullptr;
+}
+
+void ThreadPool::__workerLoop(uint32_t thread)
+{
+	auto last_generation = uint64_t{ 0 };
+	while (true)
+	{
+		auto job = static_cast<void (*)(void*, uint32_t)>(nullptr);
+		auto context = static_cast<void*>(nullptr);
+		{
+			auto lock = std::unique_lock(__mutex);
+			__job_ready.wait(lock, [&] { return __stopping || __job_generation != last_generation; });
+			if (__stopping)
+				return;
+			last_generation = __job_generation;
+			job = __job;
+			context = __job_context;
+		}
+
+		job(context, thread);
+
+		auto lock = std::lock_guard(__mutex);
+		if (--__busy_workers == 0)
+			__job_done.notify_one();
+	}
+}
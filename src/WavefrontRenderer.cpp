@@ -0,0 +1,336 @@
+#include "WavefrontRenderer.hpp"
+#include "Scene.hpp"
+#include "Sampler/ISampler.hpp"
+#include "Material/MaterialTable.hpp"
+
+#include <limits>
+#include <cassert>
+
+namespace
+{
+	constexpr auto t_min = 1e-3f;
+	constexpr auto t_max = std::numeric_limits<float>::infinity();
+
+	constexpr auto chunk_size = 64u;			// paths handed out at a time to the threads of a stage
+	constexpr auto block_size = 4096u;		// entries of a queue sorted or compacted by one thread
+}
+
+/**
+ * ============================================
+ *		PUBLIC
+ * ============================================
+ */
+
+void WavefrontRenderer::computeRayColors(std::span<const Ray> camera_rays,
+																				 std::span<const glm::uvec2> pixels,
+																				 std::span<const uint32_t> sample_indices,
+																				 const Scene& scene,
+																				 const ISampler& sampler,
+																				 std::span<glm::vec3> radiance,
+																				 uint32_t max_depth,
+																				 uint32_t russian_roulette_depth,
+																				 LightSelection light_selection,
+																				 std::span<AuxiliarySample> auxiliary)
+{
+	assert(pixels.size() == camera_rays.size() && sample_indices.size() == camera_rays.size() && radiance.size() == camera_rays.size());
+	assert(auxiliary.empty() || auxiliary.size() == camera_rays.size());
+	const auto path_count = static_cast<uint32_t>(camera_rays.size());
+	__light_selection = light_selection;
+	__auxiliary = auxiliary;
+	__resize(path_count, Renderer::getLightSampleCount(scene, light_selection));
+	__samplers.clear();
+	for (auto i = 0u; i < __thread_pool.getThreadCount(); ++i)
+		__samplers.push_back(sampler.clone());
+
+	// Generate: every path starts with its camera ray
+	__parallelFor(path_count, [&](uint32_t path) {
+		__ray_origin[path] = camera_rays[path].origin;
+		__ray_direction[path] = camera_rays[path].direction;
+		__pixel[path] = pixels[path];
+		__sample_index[path] = sample_indices[path];
+		__dimension[path] = ISampler::CAMERA_DIMENSIONS;
+		__throughput[path] = glm::vec3(1.f);
+		__bsdf_pdf[path] = 0.f;
+		__radiance[path] = glm::vec3(0.f);
+		__ray_queue[path] = path;
+		__auxiliary_pending[path] = !__auxiliary.empty();
+		__auxiliary_albedo[path] = glm::vec3(1.f);
+		__auxiliary_distance[path] = 0.f;
+		if (!__auxiliary.empty())
+			__auxiliary[path] = AuxiliarySample{};
+	});
+	__ray_count = path_count;
+
+	for (auto depth = 0u; depth < max_depth && __ray_count > 0; ++depth)
+	{
+		__extend(scene);
+		__shade(scene, depth, russian_roulette_depth);
+		__traceShadowRays(scene);
+		__accumulate();
+	}
+
+	__parallelFor(path_count, [&](uint32_t path) {
+		radiance[path] = __radiance[path];
+	});
+	__auxiliary = {};
+}
+
+/**
+ * ============================================
+ *		PRIVATE
+ * ============================================
+ */
+
+void WavefrontRenderer::__resize(uint32_t path_count, uint32_t light_sample_count)
+{
+	__light_sample_count = light_sample_count;
+	__ray_origin.resize(path_count);
+	__ray_direction.resize(path_count);
+	__throughput.resize(path_count);
+	__bsdf_pdf.resize(path_count);
+	__radiance.resize(path_count);
+	__flags.resize(path_count);
+	__pixel.resize(path_count);
+	__sample_index.resize(path_count);
+	__dimension.resize(path_count);
+	__auxiliary_pending.resize(path_count);
+	__auxiliary_albedo.resize(path_count);
+	__auxiliary_distance.resize(path_count);
+
+	__hit_point.resize(path_count);
+	__hit_normal.resize(path_count);
+	__hit_texture_coordinates.resize(path_count);
+	__hit_material.resize(path_count);
+	__hit_outside.resize(path_count);
+	__hit_light.resize(path_count);
+
+	__shading_throughput.resize(path_count);
+
+	auto shadow_count = static_cast<size_t>(path_count) * light_sample_count;
+	__shadow_direction.resize(shadow_count);
+	__shadow_distance.resize(shadow_count);
+	__shadow_contribution.resize(shadow_count);
+	__shadow_visible.resize(shadow_count);
+
+	__ray_queue.resize(path_count);
+	__hit_queue.resize(path_count);
+	__sorted_hit_queue.resize(path_count);
+	__light_sampling_queue.resize(path_count);
+}
+
+void WavefrontRenderer::__extend(const Scene& scene)
+{
+	__parallelFor(__ray_count, [&](uint32_t i) {
+		auto path = __ray_queue[i];
+		auto hit = HitRecord{};
+		if (!scene.rayCasting(__loadRay(path), t_min, t_max, hit))
+		{
+			__flags[path] = 0;
+			return;
+		}
+		__flags[path] = PATH_HIT;
+		__hit_point[path] = hit.point;
+		__hit_normal[path] = hit.normal;
+		__hit_texture_coordinates[path] = glm::vec2(hit.tc_u, hit.tc_v);
+		__hit_material[path] = hit.material_id;
+		__hit_outside[path] = hit.is_ray_outside;
+		__hit_light[path] = hit.light_id;
+	});
+
+	// Paths that missed the scene end here
+	__hit_count = __compact(std::span(__ray_queue.data(), __ray_count), PATH_HIT, __hit_queue);
+}
+
+void WavefrontRenderer::__shade(const Scene& scene, uint32_t depth, uint32_t russian_roulette_depth)
+{
+	const auto& materials = scene.getMaterialTable();
+	__sortHitsByMaterial(materials.getMaterialCount());
+
+	__parallelFor(__hit_count, [&](uint32_t i, uint32_t worker) {
+		auto path = __sorted_hit_queue[i];
+		auto& sampler = *__samplers[worker];
+		sampler.startPixelSample(__pixel[path], __sample_index[path], __dimension[path]);
+		auto incident = __loadRay(path);
+
+		auto hit = HitRecord{};
+		hit.point = __hit_point[path];
+		hit.normal = __hit_normal[path];
+		hit.tc_u = __hit_texture_coordinates[path].x;
+		hit.tc_v = __hit_texture_coordinates[path].y;
+		hit.is_ray_outside = __hit_outside[path];
+		hit.material_id = __hit_material[path];
+		if (__auxiliary_pending[path])
+		{
+			__auxiliary_distance[path] += glm::length(hit.point - incident.origin);
+			__auxiliary_pending[path] = materials.isSpecular(hit.material_id);
+			if (!__auxiliary_pending[path])
+				__auxiliary[path] = Renderer::computeAuxiliarySample(scene, hit, __auxiliary_albedo[path], __auxiliary_distance[path]);
+		}
+
+		auto emitted_color = materials.emitted(hit.material_id, hit.tc_u, hit.tc_v);
+		auto emission_weight = Renderer::computeEmissionWeight(scene, __light_selection, __hit_light[path], incident.origin, hit.point, __bsdf_pdf[path]);
+		__radiance[path] += __throughput[path] * emitted_color * emission_weight;
+
+		auto scattered_ray = Ray();
+		auto material_scatter_color = glm::vec3();
+		auto scatters = materials.scatter(hit.material_id, incident, hit, sampler.get2D(), material_scatter_color, scattered_ray);
+		if (!scatters && !materials.isGlossy(hit.material_id))
+			return;
+
+		// Shadow rays towards the lights, with the contribution they add if nothing blocks them
+		auto is_specular = materials.isSpecular(hit.material_id);
+		auto outgoing = -glm::normalize(incident.direction);
+		if (is_specular)
+			sampler.skipDimensions(Renderer::getLightSamplingDimensions(scene, __light_selection));
+		else
+		{
+			__flags[path] |= PATH_SAMPLES_LIGHTS;
+			for (auto light_sample = 0u; light_sample < __light_sample_count; ++light_sample)
+			{
+				auto entry = static_cast<size_t>(path) * __light_sample_count + light_sample;
+				auto selection_pmf = 0.f;
+				auto light_index = Renderer::selectLight(scene, __light_selection, light_sample, sampler, selection_pmf);
+				auto u = sampler.get2D();
+				if (!Renderer::sampleLight(scene, light_index, selection_pmf, hit, outgoing, u, __shadow_direction[entry], __shadow_distance[entry], __shadow_contribution[entry]))
+					__shadow_distance[entry] = 0.f;
+			}
+		}
+
+		__shading_throughput[path] = __throughput[path];
+		if (!scatters)
+			return;
+		if (__auxiliary_pending[path])
+			__auxiliary_albedo[path] *= material_scatter_color;
+		__throughput[path] *= material_scatter_color;
+		__bsdf_pdf[path] = is_specular ? 0.f : materials.pdf(hit.material_id, hit, outgoing, scattered_ray.direction);
+
+		// Russian roulette, whose dimension is drawn at every bounce
+		auto survival_u = sampler.get1D();
+		if (depth + 1 >= russian_roulette_depth)
+		{
+			const auto& throughput = __throughput[path];
+			auto survival_probability = glm::min(glm::max(throughput.r, glm::max(throughput.g, throughput.b)), 0.95f);
+			if (survival_u >= survival_probability)
+				return;
+			__throughput[path] /= survival_probability;
+		}
+		__flags[path] |= PATH_CONTINUES;
+		__dimension[path] = sampler.getDimension();
+		__ray_origin[path] = scattered_ray.origin;
+		__ray_direction[path] = scattered_ray.direction;
+	});
+
+	auto hits = std::span(__hit_queue.data(), __hit_count);
+	__light_sampling_count = __compact(hits, PATH_SAMPLES_LIGHTS, __light_sampling_queue);
+	__ray_count = __compact(hits, PATH_CONTINUES, __ray_queue);
+}
+
+void WavefrontRenderer::__traceShadowRays(const Scene& scene)
+{
+	const auto shadow_count = __light_sampling_count * __light_sample_count;
+	__parallelFor(shadow_count, [&](uint32_t i) {
+		auto path = __light_sampling_queue[i / __light_sample_count];
+		auto entry = static_cast<size_t>(path) * __light_sample_count + i % __light_sample_count;
+		if (__shadow_distance[entry] == 0.f)
+		{
+			__shadow_visible[entry] = false;
+			return;
+		}
+		auto shadow_ray = Ray(__hit_point[path], __shadow_direction[entry]);
+		__shadow_visible[entry] = !scene.occluded(shadow_ray, t_min, __shadow_distance[entry]);
+	});
+}
+
+void WavefrontRenderer::__accumulate()
+{
+	__parallelFor(__light_sampling_count, [&](uint32_t i) {
+		auto path = __light_sampling_queue[i];
+		auto direct_illumination = glm::vec3(0.0f);
+		for (auto light_sample = 0u; light_sample < __light_sample_count; ++light_sample)
+		{
+			auto entry = static_cast<size_t>(path) * __light_sample_count + light_sample;
+			if (__shadow_visible[entry])
+				direct_illumination += __shadow_contribution[entry];
+		}
+		__radiance[path] += __shading_throughput[path] * direct_illumination;
+	});
+}
+
+/**
+ * @brief
+ * Parallel counting sort: the hit queue is cut in blocks, and each thread counts the materials of its blocks.
+ * The counts are laid out material by material, and block by block within a material, so their prefix sum
+ * gives the position of the first path of each material in each block: the blocks then write their paths
+ * in parallel, and the order of the paths within a material is the order of the queue.
+ */
+void WavefrontRenderer::__sortHitsByMaterial(uint32_t material_count)
+{
+	// Paths without a material (NO_MATERIAL) go in a last bucket: MaterialTable shades them black, and they end there
+	const auto bucket_count = material_count + 1;
+	const auto block_count = (__hit_count + block_size - 1) / block_size;
+	auto bucket = [&](uint32_t path) { return glm::min(__hit_material[path], material_count); };
+	__material_offsets.assign(static_cast<size_t>(bucket_count) * block_count, 0u);
+	__thread_pool.parallelFor(block_count, 1u, [&](uint32_t block) {
+		auto last = glm::min((block + 1) * block_size, __hit_count);
+		for (auto i = block * block_size; i < last; ++i)
+			++__material_offsets[static_cast<size_t>(bucket(__hit_queue[i])) * block_count + block];
+	});
+
+	auto offset = 0u;
+	for (auto& entry : __material_offsets)
+	{
+		auto count = entry;
+		entry = offset;
+		offset += count;
+	}
+
+	__thread_pool.parallelFor(block_count, 1u, [&](uint32_t block) {
+		auto last = glm::min((block + 1) * block_size, __hit_count);
+		for (auto i = block * block_size; i < last; ++i)
+		{
+			auto path = __hit_queue[i];
+			__sorted_hit_queue[__material_offsets[static_cast<size_t>(bucket(path)) * block_count + block]++] = path;
+		}
+	});
+}
+
+/** @brief Same scheme as __sortHitsByMaterial, with two buckets: the blocks count their paths, then copy them */
+uint32_t WavefrontRenderer::__compact(std::span<const uint32_t> source, uint8_t flag, std::vector<uint32_t>& queue)
+{
+	const auto source_count = static_cast<uint32_t>(source.size());
+	const auto block_count = (source_count + block_size - 1) / block_size;
+	__block_offsets.assign(block_count + 1, 0u);
+	__thread_pool.parallelFor(block_count, 1u, [&](uint32_t block) {
+		auto last = glm::min((block + 1) * block_size, source_count);
+		auto count = 0u;
+		for (auto i = block * block_size; i < last; ++i)
+			count += (__flags[source[i]] & flag) != 0;
+		__block_offsets[block + 1] = count;
+	});
+
+	for (auto block = 0u; block < block_count; ++block)
+		__block_offsets[block + 1] += __block_offsets[block];
+
+	__thread_pool.parallelFor(block_count, 1u, [&](uint32_t block) {
+		auto last = glm::min((block + 1) * block_size, source_count);
+		auto count = __block_offsets[block];
+		for (auto i = block * block_size; i < last; ++i)
+			if (__flags[source[i]] & flag)
+				queue[count++] = source[i];
+	});
+	return __block_offsets[block_count];
+}
+
+template<typename Function>
+void WavefrontRenderer::__parallelFor(uint32_t count, Function&& function)
+{
+	__thread_pool.parallelFor(count, chunk_size, std::forward<Function>(function));
+}
+
+Ray WavefrontRenderer::__loadRay(uint32_t path) const
+{
+	auto ray = Ray();
+	ray.origin = __ray_origin[path];
+	ray.direction = __ray_direction[path];
+	return ray;
+}
@@ -76,12 +76,15 @@ int main()
   scene.add(sphere_object_2);
   scene.add(sphere_object_3);
   scene.add(sphere_object_light_1);
+  scene.build();
   
   // Render
   camera.captureImage(scene);
-  camera.applyGammaCorrection(2.2f);
+  camera.resolveImage(2.2f);
   auto data = camera.getImageData();
   ImageLoader::writePNG("image_cpu_2_samples512.png", image_resolution, data);
+  if (camera.adaptive_sampling)
+    ImageLoader::writePNG("image_cpu_2_sample_counts.png", image_resolution, camera.computeSampleCountHeatmap().get());
 
   return 0;
 }
\ No newline at end of file